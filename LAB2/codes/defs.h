@@ -78,6 +78,8 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(int, int);
+void            lapictimer(int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
@@ -112,6 +114,9 @@ struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+int             mlfqtick(struct proc*);
+void            mlfqboost(void);
+int             setpriority(int, int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
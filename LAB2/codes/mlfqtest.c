@@ -0,0 +1,64 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NCPUBOUND 3
+#define NROUNDS  20
+
+void
+cpu_bound(int id)
+{
+  volatile int x = 0;
+  int i;
+
+  for(i = 0; i < 300000000; i++)
+    x++;
+  printf(1, "CPU-bound child %d finished at tick %d\n", id, uptime());
+  exit();
+}
+
+// Sleep one tick at a time and record how long it takes to
+// get the cpu back after each wakeup.
+void
+interactive(void)
+{
+  int i, t0, late, total = 0, worst = 0;
+
+  for(i = 0; i < NROUNDS; i++){
+    t0 = uptime();
+    sleep(1);
+    late = uptime() - t0 - 1;
+    if(late < 0)
+      late = 0;
+    total += late;
+    if(late > worst)
+      worst = late;
+  }
+  printf(1, "Interactive child: %d extra ticks over %d sleeps, worst %d\n",
+         total, NROUNDS, worst);
+  exit();
+}
+
+int
+main(void)
+{
+  int i;
+
+  printf(1, "Starting MLFQ test at tick %d...\n", uptime());
+
+  for(i = 0; i < NCPUBOUND; i++){
+    if(fork() == 0)
+      cpu_bound(i);
+  }
+
+  // Let the CPU-bound children sink to the lowest level first.
+  sleep(20);
+
+  if(fork() == 0)
+    interactive();
+
+  for(i = 0; i < NCPUBOUND + 1; i++)
+    wait();
+  printf(1, "MLFQ test finished.\n");
+  exit();
+}
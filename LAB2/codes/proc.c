@@ -4,6 +4,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
 
@@ -13,6 +14,16 @@
 
 struct ptable ptable;
 
+// Multi-level feedback queues of RUNNABLE processes,
+// protected by ptable.lock.  Each level is round robin;
+// quantum[] is how many ticks a process may use at a level
+// before it is demoted to the next one.
+static struct {
+  struct proc *head;
+  struct proc *tail;
+} mlfq[NMLFQ];
+static int quantum[NMLFQ] = { 1, 2, 4 };
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -20,6 +31,8 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void kick(void);
+static void mlfqpush(struct proc *p);
 
 void
 pinit(void)
@@ -90,6 +103,8 @@ found:
   p->state = EMBRYO;
   p->pid = nextpid++;
   p->priority = 1;
+  p->level = p->priority;
+  p->tick_count = 0;
 
   release(&ptable.lock);
 
@@ -151,6 +166,8 @@ userinit(void)
   acquire(&ptable.lock);
 
   p->state = RUNNABLE;
+  mlfqpush(p);
+  kick();
 
   release(&ptable.lock);
 }
@@ -217,6 +234,8 @@ fork(void)
   acquire(&ptable.lock);
 
   np->state = RUNNABLE;
+  mlfqpush(np);
+  kick();
 
   release(&ptable.lock);
 
@@ -313,6 +332,187 @@ wait(void)
   }
 }
 
+// Append p to the queue of its current level.
+// Caller holds ptable.lock.
+static void
+mlfqpush(struct proc *p)
+{
+  p->qnext = 0;
+  if(mlfq[p->level].tail)
+    mlfq[p->level].tail->qnext = p;
+  else
+    mlfq[p->level].head = p;
+  mlfq[p->level].tail = p;
+}
+
+// Remove and return the head of the highest non-empty level,
+// or 0 if nothing is runnable.  Caller holds ptable.lock.
+static struct proc*
+mlfqpop(void)
+{
+  struct proc *p;
+  int i;
+
+  for(i = 0; i < NMLFQ; i++){
+    if((p = mlfq[i].head) != 0){
+      mlfq[i].head = p->qnext;
+      if(mlfq[i].head == 0)
+        mlfq[i].tail = 0;
+      p->qnext = 0;
+      return p;
+    }
+  }
+  return 0;
+}
+
+// Unlink p, which is RUNNABLE, from its queue.
+// Caller holds ptable.lock.
+static void
+mlfqremove(struct proc *p)
+{
+  struct proc **pp, *prev;
+
+  prev = 0;
+  for(pp = &mlfq[p->level].head; *pp; pp = &(*pp)->qnext){
+    if(*pp == p){
+      *pp = p->qnext;
+      if(mlfq[p->level].tail == p)
+        mlfq[p->level].tail = prev;
+      p->qnext = 0;
+      return;
+    }
+    prev = *pp;
+  }
+}
+
+// Called on every clock tick for the running process p, after
+// its tick_count was bumped.  Should p give up the cpu?  Yes if
+// it used up the quantum of its level or a process is waiting
+// at a higher level.
+int
+mlfqtick(struct proc *p)
+{
+  int i;
+
+  if(p->tick_count >= quantum[p->level])
+    return 1;
+  for(i = 0; i < p->level; i++)
+    if(mlfq[i].head)
+      return 1;
+  return 0;
+}
+
+// Priority boost: every MLFQBOOST ticks move every process
+// back to its base level so demoted CPU-bound jobs can't be
+// starved.  Queued processes keep their relative order.
+void
+mlfqboost(void)
+{
+  struct proc *p, *next, *old[NMLFQ];
+  int i;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state == UNUSED || p->state == RUNNABLE)
+      continue;
+    p->level = p->priority;
+    p->tick_count = 0;
+  }
+  for(i = 0; i < NMLFQ; i++){
+    old[i] = mlfq[i].head;
+    mlfq[i].head = mlfq[i].tail = 0;
+  }
+  for(i = 0; i < NMLFQ; i++){
+    for(p = old[i]; p; p = next){
+      next = p->qnext;
+      p->level = p->priority;
+      p->tick_count = 0;
+      mlfqpush(p);
+    }
+  }
+  release(&ptable.lock);
+}
+
+// Set the base level of process pid; it also restarts there.
+int
+setpriority(int pid, int priority)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid == pid){
+      if(p->state == RUNNABLE)
+        mlfqremove(p);
+      p->priority = priority;
+      p->level = priority;
+      p->tick_count = 0;
+      if(p->state == RUNNABLE)
+        mlfqpush(p);
+      release(&ptable.lock);
+      return 0;
+    }
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+// A process just became RUNNABLE: send a wakeup IPI to one
+// cpu halted in idle(), if any.  Clearing its idle flag
+// claims it, so a burst of wakeups wakes a different cpu
+// for each process.  Caller holds ptable.lock.
+static void
+kick(void)
+{
+  struct cpu *c;
+
+  // Pairs with the barrier in idle(): either we see the
+  // idle flag or the idle cpu sees the RUNNABLE process.
+  __sync_synchronize();
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->idle && __sync_bool_compare_and_swap(&c->idle, 1, 0)){
+      lapicipi(c->apicid, T_IRQ0 + IRQ_WAKE);
+      return;
+    }
+  }
+}
+
+static int
+anyrunnable(void)
+{
+  int i;
+
+  for(i = 0; i < NMLFQ; i++)
+    if(mlfq[i].head)
+      return 1;
+  return 0;
+}
+
+// Nothing to run: halt until an interrupt arrives instead of
+// rescanning the table under ptable.lock.  kick() sends a
+// halted cpu a wakeup IPI when a process becomes RUNNABLE,
+// clearing c->idle first; a cleared flag means we have been
+// woken.  The lapic timer is stopped meanwhile on every cpu
+// but cpu 0, which keeps ticks.
+static void
+idle(struct cpu *c)
+{
+  cli();
+  c->idle = 1;
+  __sync_synchronize();
+  if(!anyrunnable() && c->idle){
+    if(c != &cpus[0])
+      lapictimer(0);
+    // sti takes effect after hlt starts, so a wakeup
+    // IPI sent after the check above still wakes us.
+    asm volatile("sti; hlt");
+    cli();
+    if(c != &cpus[0])
+      lapictimer(1);
+  }
+  c->idle = 0;
+}
+
 //PAGEBREAK: 42
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
@@ -325,8 +525,6 @@ void
 scheduler(void)
 {
   struct proc *p;
-  struct proc *best_p = 0;  
-  int best_priority = 4;   
   struct cpu *c = mycpu();
   c->proc = 0;
   
@@ -334,22 +532,9 @@ scheduler(void)
     sti();
 
     acquire(&ptable.lock);
-    
-    best_p = 0;
-    best_priority = 4;  
-
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
-      if(p->priority < best_priority) {
-        best_priority = p->priority;
-        best_p = p;
-      }
-    }
-
-    if (best_p) {
-      p = best_p;  
 
+    // Round robin within the highest non-empty level.
+    if((p = mlfqpop()) != 0){
       c->proc = p;
       switchuvm(p);
       p->state = RUNNING;
@@ -360,6 +545,9 @@ scheduler(void)
     }
     
     release(&ptable.lock);
+
+    if(p == 0)
+      idle(c);
   }
 }
 
@@ -393,8 +581,17 @@ sched(void)
 void
 yield(void)
 {
+  struct proc *p = myproc();
+
   acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  if(p->tick_count >= quantum[p->level]){
+    // Used its whole quantum: demote.
+    if(p->level < NMLFQ-1)
+      p->level++;
+    p->tick_count = 0;
+  }
+  p->state = RUNNABLE;
+  mlfqpush(p);
   sched();
   release(&ptable.lock);
 }
@@ -468,8 +665,11 @@ wakeup1(void *chan)
   struct proc *p;
 
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      mlfqpush(p);
+      kick();
+    }
 }
 
 // Wake up all processes sleeping on chan.
@@ -494,8 +694,11 @@ kill(int pid)
     if(p->pid == pid){
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
+      if(p->state == SLEEPING){
         p->state = RUNNABLE;
+        mlfqpush(p);
+        kick();
+      }
       release(&ptable.lock);
       return 0;
     }
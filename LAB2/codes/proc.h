@@ -4,6 +4,8 @@
 #include "spinlock.h"  
 #include "param.h"
 
+#define NMLFQ      3    // feedback queue levels, 0 runs first
+#define MLFQBOOST 100   // ticks between priority boosts
  
 struct context {
   uint edi;
@@ -21,7 +23,10 @@ struct proc {
   char *kstack;                // Bottom of kernel stack for this process
   enum procstate state;        // Process state
   int pid;                     // Process ID
-  int priority;
+  int priority;                // Base MLFQ level (set_priority_syscall)
+  int level;                   // Current MLFQ level
+  int tick_count;              // Ticks used at the current level
+  struct proc *qnext;          // Next process on an MLFQ queue
   struct proc *parent;         // Parent process
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
@@ -41,6 +46,7 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile uint idle;          // Halted in idle() waiting for work
 };
 
 struct ptable {
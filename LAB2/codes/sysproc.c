@@ -179,23 +179,12 @@ int
 sys_set_priority_syscall(void)
 {
   int pid, priority;
-  struct proc *p;
 
   if (argint(0, &pid) < 0 || argint(1, &priority) < 0)
     return -1;
 
-  if (priority < 0 || priority > 2)
+  if (priority < 0 || priority >= NMLFQ)
     return -1;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->priority = priority;  
-      release(&ptable.lock);
-      return 0;  
-    }
-  }
-
-  release(&ptable.lock);
-  return -1;
+  return setpriority(pid, priority);
 }
\ No newline at end of file
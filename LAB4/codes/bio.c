@@ -39,7 +39,7 @@ binit(void)
 {
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  initqlock(&bcache.lock, "bcache");
 
 //PAGEBREAK!
   // Create linked list of buffers
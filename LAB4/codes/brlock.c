@@ -0,0 +1,70 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "brlock.h"
+
+void
+brlock_init(struct brlock *br, char *name)
+{
+  int i;
+
+  initlock(&br->wlk, "brlock");
+  br->name = name;
+  br->writer = 0;
+  for(i = 0; i < NCPU; i++)
+    br->slot[i].readers = 0;
+}
+
+void
+brlock_read_lock(struct brlock *br)
+{
+  struct brslot *s;
+
+  pushcli();  // stay on this cpu until brlock_read_unlock()
+  s = &br->slot[mycpu() - cpus];
+  for(;;){
+    s->readers++;
+    // The count must be visible before we look at the
+    // writer flag, or a writer could miss us.
+    __sync_synchronize();
+    if(!br->writer)
+      break;
+    s->readers--;
+    while(br->writer)
+      asm volatile("pause");
+  }
+}
+
+void
+brlock_read_unlock(struct brlock *br)
+{
+  __sync_synchronize();
+  br->slot[mycpu() - cpus].readers--;
+  popcli();
+}
+
+void
+brlock_write_lock(struct brlock *br)
+{
+  int i;
+
+  acquire(&br->wlk);
+  br->writer = 1;
+  __sync_synchronize();
+  for(i = 0; i < ncpu; i++)
+    while(br->slot[i].readers)
+      asm volatile("pause");
+}
+
+void
+brlock_write_unlock(struct brlock *br)
+{
+  __sync_synchronize();
+  br->writer = 0;
+  release(&br->wlk);
+}
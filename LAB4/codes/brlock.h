@@ -0,0 +1,22 @@
+#ifndef __BRLOCK_H__
+#define __BRLOCK_H__
+
+#include "spinlock.h"
+#include "param.h"
+
+// Big-reader lock for read-mostly data.  A reader bumps only
+// its own cpu's count, on its own cache line; a writer sets
+// the writer flag and waits for every cpu's count to drain.
+// Readers run with interrupts off and must not sleep.
+struct brslot {
+  volatile uint readers;
+} __attribute__((aligned(64)));
+
+struct brlock {
+  struct brslot slot[NCPU];
+  volatile uint writer;   // A writer holds or wants the lock
+  struct spinlock wlk;    // Serializes writers
+  char *name;
+};
+
+#endif
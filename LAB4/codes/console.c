@@ -10,6 +10,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "kbd.h"
+#include "brlock.h"
 
 static void consputc(int);
 
@@ -40,8 +41,11 @@ static struct {
 #define MAX_COMMANDS 64
 #define MAX_CMD_LEN  32
 
+// Completion table, set by the shell and read on every tab
+// press; protected by cmdlock rather than cons.lock.
 static char dynamic_commands[MAX_COMMANDS][MAX_CMD_LEN];
 static char* dynamic_command_ptrs[MAX_COMMANDS + 1];
+static struct brlock cmdlock;
 
 static int tab_press_count = 0;
 
@@ -571,7 +575,9 @@ consoleintr(int (*getc)(void))
 
     case TAB_KEY:
       clear_selection_highlight();
+      brlock_read_lock(&cmdlock);
       handle_tab_completion();
+      brlock_read_unlock(&cmdlock);
       break;
 
     case KEY_LF:
@@ -794,7 +800,6 @@ int
 consolewrite(struct inode *ip, char *buf, int n)
 {
   iunlock(ip);
-  acquire(&cons.lock);
 
   if (n > 4 && (uchar)buf[0] == 1 && (uchar)buf[1] == 1 && (uchar)buf[n-2] == 2 && (uchar)buf[n-1] == 2) {
     char *p = buf + 2;
@@ -802,6 +807,7 @@ consolewrite(struct inode *ip, char *buf, int n)
     int cmd_idx = 0;
     int char_idx = 0;
 
+    brlock_write_lock(&cmdlock);
     memset(dynamic_commands, 0, sizeof(dynamic_commands));
     
     while (p < end && cmd_idx < MAX_COMMANDS) {
@@ -816,12 +822,13 @@ consolewrite(struct inode *ip, char *buf, int n)
       p++;
     }
     dynamic_command_ptrs[cmd_idx] = 0;
+    brlock_write_unlock(&cmdlock);
 
-    release(&cons.lock);
     ilock(ip);
     return n;
   }
 
+  acquire(&cons.lock);
   for (int i = 0; i < n; i++)
     consputc(buf[i] & 0xff);
   
@@ -835,6 +842,7 @@ void
 consoleinit(void)
 {
   initlock(&cons.lock, "console");
+  brlock_init(&cmdlock, "cmdlock");
 
   devsw[CONSOLE].write = consolewrite;
   devsw[CONSOLE].read = consoleread;
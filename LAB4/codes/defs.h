@@ -1,14 +1,20 @@
 struct buf;
 struct context;
+struct cpu;
 struct file;
 struct inode;
 struct pipe;
 struct proc;
 struct rtcdate;
 struct spinlock;
+struct lockstat;
+struct kallocstat;
 struct sleeplock;
+struct waitq;
+struct procstat;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
@@ -53,6 +59,11 @@ int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
+// futex.c
+void            futexinit(void);
+int             futexwait(uint, uint);
+int             futexwake(uint, int);
+
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
@@ -68,6 +79,9 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kref(char*);
+int             kpageref(char*);
+void            kallocstat(struct kallocstat*);
 
 // kbd.c
 void            kbdintr(void);
@@ -78,6 +92,8 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(int, int);
+void            lapictimer(int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
@@ -119,7 +135,17 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
+void            sleepq(struct waitq*, struct spinlock*);
+struct proc*    wakeone(struct waitq*);
+void            wakeproc(struct proc*, void*);
+void            waitqremove(struct waitq*, struct proc*);
+int             procsnap(struct proc*, struct procstat*);
+void            piboost(struct proc*, int);
+void            pidrop(void);
+int             needresched(void);
+void            wakeall(struct waitq*);
 void            yield(void);
+extern int      quantum[];
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -129,6 +155,11 @@ void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initqlock(struct spinlock*, char*);
+int             lockavgspin(struct spinlock*, int);
+int             lockclass(char*);
+char*           lockclassname(int);
+int             lockstat(int, struct lockstat*);
 void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
@@ -139,6 +170,23 @@ void            rwlock_acquire_read(struct rwlock*);
 void            rwlock_release_read(struct rwlock*);
 void            rwlock_acquire_write(struct rwlock*);
 void            rwlock_release_write(struct rwlock*);
+int             rwlock_setpolicy(struct rwlock*, int);
+
+// brlock.c
+struct brlock;
+void            brlock_init(struct brlock*, char*);
+void            brlock_read_lock(struct brlock*);
+void            brlock_read_unlock(struct brlock*);
+void            brlock_write_lock(struct brlock*);
+void            brlock_write_unlock(struct brlock*);
+
+// rcu.c
+void            rcu_read_lock(void);
+void            rcu_read_unlock(void);
+void            rcu_quiescent(struct cpu*);
+uint            rcu_retire(void);
+int             rcu_done(uint);
+void            rcu_wait(uint);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -158,6 +206,7 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argptrw(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
@@ -168,6 +217,7 @@ void            timerinit(void);
 
 // trap.c
 void            idtinit(void);
+uint            readticks(void);
 extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
@@ -183,11 +233,23 @@ void            kvmalloc(void);
 pde_t*          setupkvm(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
+int             allocshm(pde_t*, uint, uint);
+int             cowfault(pde_t*, uint);
+int             lazyfault(pde_t*, uint, uint);
+int             vmafault(struct proc*, uint);
+struct vma*     vmalookup(struct vma*, uint);
+int             vmaoverlap(struct vma*, uint, uint);
+void            vmaput(pde_t*, struct vma*);
+void            vmaclear(pde_t*, struct vma*);
+void            vmadup(struct vma*, struct vma*);
+int             uvmvalid(struct proc*, uint, uint, int);
+int             uvmfault(struct proc*, uint, int);
+int             uvmpopulate(uint, uint);
 int             deallocuvm(pde_t*, uint, uint);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
-pde_t*          copyuvm(pde_t*, uint);
+pde_t*          copyuvm(pde_t*, uint, struct vma*);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
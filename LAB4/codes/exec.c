@@ -5,7 +5,12 @@
 #include "proc.h"
 #include "defs.h"
 #include "x86.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
 #include "elf.h"
+#include "mman.h"
 
 int
 exec(char *path, char **argv)
@@ -16,9 +21,14 @@ exec(char *path, char **argv)
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct vma vma[NVMA];
+  int nvma;
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
 
+  memset(vma, 0, sizeof(vma));
+  nvma = 0;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -38,7 +48,11 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Map the program's segments.  Nothing is read yet:
+  // vmafault() reads each page from ip on first touch.  As
+  // nothing stops writes to ip meanwhile, rewriting or
+  // truncating the binary of a running program changes what
+  // it later pages in, or kills it on a read past the end.
   sz = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
@@ -49,12 +63,26 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.off + ph.filesz < ph.off || ph.off + ph.filesz > ip->size)
+      goto bad;
+    if(ph.memsz == 0)
+      continue;
+    if(nvma == NVMA)
       goto bad;
+    vma[nvma].start = ph.vaddr;
+    vma[nvma].end = ph.vaddr + ph.memsz;
+    vma[nvma].ip = idup(ip);
+    vma[nvma].off = ph.off;
+    vma[nvma].filesz = ph.filesz;
+    vma[nvma].prot = PROT_READ|PROT_WRITE;
+    vma[nvma].flags = MAP_PRIVATE;
+    nvma++;
+    if(ph.vaddr + ph.memsz > sz)
+      sz = ph.vaddr + ph.memsz;
   }
   iunlockput(ip);
   end_op();
@@ -91,7 +119,11 @@ exec(char *path, char **argv)
   for(last=s=path; *s; s++)
     if(*s == '/')
       last = s+1;
+  acquire(&curproc->lock);
+  write_seqbegin(&curproc->statseq);
   safestrcpy(curproc->name, last, sizeof(curproc->name));
+  write_seqend(&curproc->statseq);
+  release(&curproc->lock);
 
   // Commit to the user image.
   oldpgdir = curproc->pgdir;
@@ -99,6 +131,8 @@ exec(char *path, char **argv)
   curproc->sz = sz;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
+  vmaclear(oldpgdir, curproc->vma);
+  memmove(curproc->vma, vma, sizeof(vma));
   switchuvm(curproc);
   freevm(oldpgdir);
   return 0;
@@ -110,5 +144,6 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  vmaclear(0, vma);
   return -1;
 }
@@ -0,0 +1,34 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define N 20
+
+// Usage: exectime [prog [args...]]
+// Runs prog (default: echo) N times and reports the average
+// time for fork, exec and exit.  With demand paging, a large
+// program that exits early only reads the pages it touches.
+int main(int argc, char *argv[]) {
+    char *echo[] = { "echo", 0 };
+    char **cmd = argc > 1 ? argv + 1 : echo;
+    int t0, t;
+
+    t0 = uptime();
+    for(int i = 0; i < N; i++) {
+        int pid = fork();
+        if(pid < 0) {
+            printf(2, "exectime: fork failed\n");
+            exit();
+        }
+        if(pid == 0) {
+            close(1);
+            exec(cmd[0], cmd);
+            exit();
+        }
+        wait();
+    }
+    t = uptime() - t0;
+    printf(1, "%s: %d runs in %d ticks, %d ticks per 10 runs\n",
+           cmd[0], N, t, t * 10 / N);
+    exit();
+}
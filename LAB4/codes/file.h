@@ -14,6 +14,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  uint rcugen;        // rcu_retire() when ref fell to zero
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -0,0 +1,60 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NFORK 200
+#define HEAP (512 * 1024)
+
+// Fork NFORK children that exit at once (touch 0) or write
+// one byte to every page of the heap first (touch 1), and
+// return the time taken in ticks.
+int run(int cow, int touch, char *heap) {
+    int t0, t;
+
+    setcow(cow);
+    t0 = uptime();
+    for(int i = 0; i < NFORK; i++) {
+        int pid = fork();
+        if(pid < 0) {
+            printf(1, "fork failed\n");
+            exit();
+        }
+        if(pid == 0) {
+            if(touch)
+                for(int j = 0; j < HEAP; j += 4096)
+                    heap[j] = 1;
+            exit();
+        }
+        wait();
+    }
+    t = uptime() - t0;
+    if(t == 0)
+        t = 1;
+    printf(1, "%s %s: %d forks in %d ticks, %d forks/sec\n",
+           cow ? "cow " : "copy", touch ? "write heap" : "exit     ",
+           NFORK, t, NFORK * 100 / t);
+    return t;
+}
+
+// Usage: forkbench
+// Compares fork+exit+wait with full copies and with
+// copy-on-write, for a process with a HEAP-byte heap.
+int main(int argc, char *argv[]) {
+    char *heap;
+    int old;
+
+    heap = sbrk(HEAP);
+    if(heap == (char*)-1) {
+        printf(1, "forkbench: sbrk failed\n");
+        exit();
+    }
+    memset(heap, 0, HEAP);
+
+    old = setcow(0);
+    run(0, 0, heap);
+    run(1, 0, heap);
+    run(0, 1, heap);
+    run(1, 1, heap);
+    setcow(old);
+    exit();
+}
@@ -157,7 +157,11 @@ bfree(int dev, uint b)
 // The icache.lock spin-lock protects the allocation of icache
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// holds, one must hold icache.lock while changing any of those
+// fields.  ip->ref is changed with atomic instructions so that
+// iget() can look up cached entries without the lock; an entry
+// whose ref falls to zero is not recycled until an rcu grace
+// period has passed (see rcu.c).
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -242,19 +246,51 @@ static struct inode*
 iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
+  uint gen = 0;
+  int r, pending;
+
+  // Fast path.  An entry seen with ref > 0 keeps its dev and
+  // inum until our read section ends, so if ref is still
+  // nonzero when we bump it, it is the inode we want.
+  rcu_read_lock();
+  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
+    r = ip->ref;
+    asm volatile("" ::: "memory");  // read ref before dev and inum
+    if(r > 0 && ip->dev == dev && ip->inum == inum &&
+       __sync_bool_compare_and_swap(&ip->ref, r, r+1)){
+      rcu_read_unlock();
+      return ip;
+    }
+  }
+  rcu_read_unlock();
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
   empty = 0;
+  pending = 0;
   for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+      __sync_fetch_and_add(&ip->ref, 1);
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+    if(empty == 0 && ip->ref == 0){    // Remember empty slot.
+      if(rcu_done(ip->rcugen))
+        empty = ip;
+      else {
+        gen = ip->rcugen;
+        pending = 1;
+      }
+    }
+  }
+
+  // Every free entry is still in its grace period: wait
+  // for one and look again.
+  if(empty == 0 && pending){
+    release(&icache.lock);
+    rcu_wait(gen);
+    return iget(dev, inum);
   }
 
   // Recycle an inode cache entry.
@@ -264,8 +300,9 @@ iget(uint dev, uint inum)
   ip = empty;
   ip->dev = dev;
   ip->inum = inum;
-  ip->ref = 1;
   ip->valid = 0;
+  __sync_synchronize();  // new dev and inum before ref
+  ip->ref = 1;
   release(&icache.lock);
 
   return ip;
@@ -276,9 +313,7 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
-  ip->ref++;
-  release(&icache.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
   return ip;
 }
 
@@ -347,7 +382,8 @@ iput(struct inode *ip)
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(__sync_sub_and_fetch(&ip->ref, 1) == 0)
+    ip->rcugen = rcu_retire();
   release(&icache.lock);
 }
 
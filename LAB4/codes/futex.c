@@ -0,0 +1,101 @@
+// Futexes: sleep and wakeup keyed by a user memory word.
+//
+// User-level locks (ulock.c) do their uncontended work with
+// atomic instructions on a word in shared memory and only
+// call futex_wait() / futex_wake() to block and unblock.
+// Waiters are keyed by the kernel address of the word, so
+// processes that map the same page at different addresses,
+// or share it through fork (PTE_SH), meet on the same key.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "waitq.h"
+
+#define NFUTEXQ 31
+
+// Waiters hashed by key.  Each bucket's lock orders a
+// waiter's check of the word against wakers.
+static struct {
+  struct spinlock lock;
+  struct waitq wq;
+} __attribute__((aligned(64))) futexq[NFUTEXQ];
+
+void
+futexinit(void)
+{
+  int i;
+
+  for(i = 0; i < NFUTEXQ; i++)
+    initlock(&futexq[i].lock, "futex");
+}
+
+// Kernel address of the user word at addr, or 0.  The word
+// may be in the heap, shmalloc() memory or an mmap() region
+// (MAP_SHARED ones can be shared with other processes).
+static uint*
+futexword(uint addr)
+{
+  struct proc *p = myproc();
+  char *ka;
+
+  if(addr % 4 || !uvmvalid(p, addr, 4, 0) || uvmpopulate(addr, 4) < 0)
+    return 0;
+  if((ka = uva2ka(p->pgdir, (char*)addr)) == 0)
+    return 0;
+  return (uint*)(ka + (addr & (PGSIZE-1)));
+}
+
+// Sleep if the word at addr still holds val.  Returns 0
+// after a wakeup, -1 if the word had changed or on error.
+int
+futexwait(uint addr, uint val)
+{
+  struct proc *p = myproc();
+  uint *w;
+  int i;
+
+  if((w = futexword(addr)) == 0)
+    return -1;
+  i = (uint)w % NFUTEXQ;
+  acquire(&futexq[i].lock);
+  if(*(volatile uint*)w != val || p->killed){
+    release(&futexq[i].lock);
+    return -1;
+  }
+  p->futex = w;
+  sleepq(&futexq[i].wq, &futexq[i].lock);
+  p->futex = 0;
+  release(&futexq[i].lock);
+  return 0;
+}
+
+// Wake up to n processes waiting on addr, oldest first.
+// Returns the number woken.
+int
+futexwake(uint addr, int n)
+{
+  struct proc *p, *next;
+  uint *w;
+  int i, woken = 0;
+
+  if((w = futexword(addr)) == 0)
+    return -1;
+  i = (uint)w % NFUTEXQ;
+  acquire(&futexq[i].lock);
+  for(p = futexq[i].wq.head; p && woken < n; p = next){
+    next = p->wq_next;
+    if(p->futex != w)
+      continue;
+    waitqremove(&futexq[i].wq, p);
+    wakeproc(p, &futexq[i].wq);
+    woken++;
+  }
+  release(&futexq[i].lock);
+  return woken;
+}
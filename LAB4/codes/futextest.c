@@ -0,0 +1,161 @@
+#include "types.h"
+#include "perfstat.h"
+#include "user.h"
+#include "ulock.h"
+
+#define NCHILD 4
+#define ITERS 20000
+#define NITEM 200
+#define NSLOT 8
+
+struct shared {
+  struct umutex m;
+  int counter;
+
+  struct umutex qm;         // Bounded buffer for the condvar test
+  struct ucond notempty;
+  struct ucond notfull;
+  int buf[NSLOT];
+  int head, tail, count;
+  int sum;
+
+  struct urwlock rw;        // Writers keep a == b
+  int a, b;
+  int bad;
+};
+
+struct shared *sh;
+
+// Each child adds ITERS to the counter, under a futex mutex
+// (kind 0) or the kernel's global plock (kind 1).
+void
+counter(int kind)
+{
+  struct perfstat ps;
+  int i, j;
+
+  sh->counter = 0;
+  start_measure();
+  for(i = 0; i < NCHILD; i++){
+    if(fork() == 0){
+      for(j = 0; j < ITERS; j++){
+        if(kind == 0){
+          umutex_lock(&sh->m);
+          sh->counter++;
+          umutex_unlock(&sh->m);
+        } else {
+          plock_acquire(1);
+          sh->counter++;
+          plock_release();
+        }
+      }
+      exit();
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    wait();
+  end_measure(&ps);
+  printf(1, "%s: counter %d (want %d), %d ticks, %d syscalls\n",
+         kind == 0 ? "futex mutex" : "plock syscall",
+         sh->counter, NCHILD*ITERS, ps.ticks, ps.nsyscall);
+}
+
+void
+producer(void)
+{
+  int i;
+
+  for(i = 1; i <= NITEM; i++){
+    umutex_lock(&sh->qm);
+    while(sh->count == NSLOT)
+      ucond_wait(&sh->notfull, &sh->qm);
+    sh->buf[sh->tail] = i;
+    sh->tail = (sh->tail + 1) % NSLOT;
+    sh->count++;
+    ucond_signal(&sh->notempty);
+    umutex_unlock(&sh->qm);
+  }
+  exit();
+}
+
+void
+consumer(void)
+{
+  int i, v;
+
+  for(i = 0; i < NITEM; i++){
+    umutex_lock(&sh->qm);
+    while(sh->count == 0)
+      ucond_wait(&sh->notempty, &sh->qm);
+    v = sh->buf[sh->head];
+    sh->head = (sh->head + 1) % NSLOT;
+    sh->count--;
+    sh->sum += v;
+    ucond_signal(&sh->notfull);
+    umutex_unlock(&sh->qm);
+  }
+  exit();
+}
+
+void
+rwreader(void)
+{
+  int i;
+
+  for(i = 0; i < ITERS; i++){
+    urw_rlock(&sh->rw);
+    if(sh->a != sh->b)
+      sh->bad = 1;
+    urw_runlock(&sh->rw);
+  }
+  exit();
+}
+
+void
+rwwriter(void)
+{
+  int i;
+
+  for(i = 0; i < ITERS/10; i++){
+    urw_wlock(&sh->rw);
+    sh->a++;
+    sh->b++;
+    urw_wunlock(&sh->rw);
+  }
+  exit();
+}
+
+int
+main(void)
+{
+  int i;
+
+  if((sh = shmalloc(sizeof(*sh))) == (void*)-1){
+    printf(1, "shmalloc failed\n");
+    exit();
+  }
+
+  counter(0);
+  counter(1);
+
+  if(fork() == 0)
+    producer();
+  if(fork() == 0)
+    consumer();
+  wait();
+  wait();
+  printf(1, "condvar: consumed sum %d (want %d)\n", sh->sum, NITEM*(NITEM+1)/2);
+
+  for(i = 0; i < NCHILD; i++){
+    if(fork() == 0){
+      if(i == 0)
+        rwwriter();
+      rwreader();
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    wait();
+  printf(1, "rwlock: %d writes, readers saw %s\n", sh->a,
+         sh->bad ? "a torn update" : "consistent data");
+  exit();
+}
@@ -8,8 +8,12 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "spinlock.h"
+#include "kallocstat.h"
 
 void freerange(void *vstart, void *vend);
+static void spill(int);
+static void refill(int);
+static struct run *drain(int);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 
@@ -23,6 +27,30 @@ struct {
   struct run *freelist;
 } kmem;
 
+// References to each physical page.  A page mapped into
+// several address spaces (PTE_SH pages after fork) is only
+// freed when the last of them calls kfree().
+static uchar pageref[PHYSTOP/PGSIZE];
+
+// Per-cpu magazines of free pages.  kalloc() and kfree()
+// use their own cpu's magazine, under its lock, which only
+// that cpu takes in the common case, and go to kmem.freelist
+// for MAGBATCH pages at a time when it runs empty or full.
+// When kmem is empty too, kalloc() takes a page from another
+// cpu's magazine before giving up.
+#define NMAG     32
+#define MAGBATCH 16
+
+static struct {
+  struct spinlock lock;
+  struct run *free;
+  int n;
+  uint hit;          // kalloc() served from the magazine
+  uint miss;         // kalloc() that had to refill it
+  uint spill;        // Batches kfree() returned to kmem
+  uint drain;        // Pages kalloc() took from other cpus
+} __attribute__((aligned(64))) kcpu[NCPU];
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -31,7 +59,11 @@ struct {
 void
 kinit1(void *vstart, void *vend)
 {
+  int c;
+
   initlock(&kmem.lock, "kmem");
+  for(c = 0; c < NCPU; c++)
+    initlock(&kcpu[c].lock, "kmag");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -48,8 +80,10 @@ freerange(void *vstart, void *vend)
 {
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
-  for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
+    pageref[V2P(p)/PGSIZE] = 1;
     kfree(p);
+  }
 }
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
@@ -60,20 +94,104 @@ void
 kfree(char *v)
 {
   struct run *r;
+  int c;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
+  if(pageref[V2P(v)/PGSIZE] == 0)
+    panic("kfree: free page");
+  if(__sync_sub_and_fetch(&pageref[V2P(v)/PGSIZE], 1) != 0)
+    return;
 
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
+  if(!kmem.use_lock){
+    // Boot time, one cpu: straight onto the global list.
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    return;
+  }
+
+  pushcli();
+  c = cpuid();
+  acquire(&kcpu[c].lock);
+  r->next = kcpu[c].free;
+  kcpu[c].free = r;
+  if(++kcpu[c].n > NMAG)
+    spill(c);
+  release(&kcpu[c].lock);
+  popcli();
+}
+
+// Move MAGBATCH pages from cpu c's magazine to kmem.
+static void
+spill(int c)
+{
+  struct run *first, *last;
+  int i;
+
+  first = last = kcpu[c].free;
+  for(i = 1; i < MAGBATCH; i++)
+    last = last->next;
+  kcpu[c].free = last->next;
+  kcpu[c].n -= MAGBATCH;
+  kcpu[c].spill++;
+
+  acquire(&kmem.lock);
+  last->next = kmem.freelist;
+  kmem.freelist = first;
+  release(&kmem.lock);
+}
+
+// Move up to MAGBATCH pages from kmem to cpu c's magazine.
+static void
+refill(int c)
+{
+  struct run *first, *last;
+  int i;
+
+  acquire(&kmem.lock);
+  first = last = kmem.freelist;
+  if(first == 0){
     release(&kmem.lock);
+    return;
+  }
+  for(i = 1; i < MAGBATCH && last->next; i++)
+    last = last->next;
+  kmem.freelist = last->next;
+  release(&kmem.lock);
+
+  last->next = kcpu[c].free;
+  kcpu[c].free = first;
+  kcpu[c].n += i;
+}
+
+// kmem is empty: take a page cached by some other cpu.
+// Called without our own magazine's lock, so that two cpus
+// draining each other cannot deadlock.
+static struct run*
+drain(int c)
+{
+  struct run *r;
+  int d;
+
+  for(d = 0; d < NCPU; d++){
+    if(d == c)
+      continue;
+    acquire(&kcpu[d].lock);
+    if((r = kcpu[d].free) != 0){
+      kcpu[d].free = r->next;
+      kcpu[d].n--;
+    }
+    release(&kcpu[d].lock);
+    if(r){
+      kcpu[c].drain++;
+      return r;
+    }
+  }
+  return 0;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,14 +201,65 @@ char*
 kalloc(void)
 {
   struct run *r;
+  int c;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  if(!kmem.use_lock){
+    r = kmem.freelist;
+    if(r)
+      kmem.freelist = r->next;
+  } else {
+    pushcli();
+    c = cpuid();
+    acquire(&kcpu[c].lock);
+    if(kcpu[c].free)
+      kcpu[c].hit++;
+    else {
+      kcpu[c].miss++;
+      refill(c);
+    }
+    r = kcpu[c].free;
+    if(r){
+      kcpu[c].free = r->next;
+      kcpu[c].n--;
+    }
+    release(&kcpu[c].lock);
+    if(r == 0)
+      r = drain(c);
+    popcli();
+  }
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    pageref[V2P(r)/PGSIZE] = 1;
   return (char*)r;
 }
 
+// Number of references to a page returned by kalloc().
+int
+kpageref(char *v)
+{
+  return pageref[V2P(v)/PGSIZE];
+}
+
+// Add a reference to a page returned by kalloc().
+void
+kref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kref");
+  __sync_fetch_and_add(&pageref[V2P(v)/PGSIZE], 1);
+}
+
+
+// Copy out the magazine counters of each cpu.
+void
+kallocstat(struct kallocstat *st)
+{
+  int c;
+
+  for(c = 0; c < NCPU; c++){
+    st[c].hit = kcpu[c].hit;
+    st[c].miss = kcpu[c].miss;
+    st[c].spill = kcpu[c].spill;
+    st[c].drain = kcpu[c].drain;
+    st[c].cached = kcpu[c].n;
+  }
+}
@@ -0,0 +1,74 @@
+#include "types.h"
+#include "stat.h"
+#include "kallocstat.h"
+#include "lockstat.h"
+#include "user.h"
+
+#define NCPU 8
+#define NSTORM 4
+#define NFORK 50
+
+struct kallocstat before[NCPU], after[NCPU];
+struct lockstat lbefore[NLOCKCLASS], lafter[NLOCKCLASS];
+
+// NSTORM processes each fork NFORK children that grow their
+// memory and exit, so every cpu allocates and frees pages.
+void storm(void) {
+    for(int i = 0; i < NSTORM; i++) {
+        if(fork() == 0) {
+            for(int j = 0; j < NFORK; j++) {
+                if(fork() == 0) {
+                    sbrk(4 * 4096);
+                    exit();
+                }
+                wait();
+            }
+            exit();
+        }
+    }
+    for(int i = 0; i < NSTORM; i++)
+        wait();
+}
+
+// Usage: kallocstat [command [args...]]
+// Runs the command, or a fork storm if none is given, and
+// prints each cpu's page magazine hits and misses during it
+// and the contention on kmem.lock.
+int main(int argc, char *argv[]) {
+    int n, nl, hit, miss;
+
+    kallocstat(before);
+    getlockstats(lbefore, NLOCKCLASS);
+    if(argc > 1) {
+        if(fork() == 0) {
+            exec(argv[1], argv + 1);
+            printf(2, "kallocstat: exec %s failed\n", argv[1]);
+            exit();
+        }
+        wait();
+    } else
+        storm();
+    n = kallocstat(after);
+    nl = getlockstats(lafter, NLOCKCLASS);
+    if(n < 0 || nl < 0) {
+        printf(2, "kallocstat: failed\n");
+        exit();
+    }
+
+    printf(1, "cpu\thits\tmisses\tspills\tdrains\tcached\thit%%\n");
+    for(int i = 0; i < n; i++) {
+        hit = after[i].hit - before[i].hit;
+        miss = after[i].miss - before[i].miss;
+        printf(1, "%d\t%d\t%d\t%d\t%d\t%d\t%d\n", i, hit, miss,
+               after[i].spill - before[i].spill,
+               after[i].drain - before[i].drain, after[i].cached,
+               hit + miss ? hit * 100 / (hit + miss) : 0);
+    }
+    for(int i = 0; i < nl; i++) {
+        if(strcmp(lafter[i].name, "kmem") == 0)
+            printf(1, "kmem lock: %d acquires, %d spins\n",
+                   lafter[i].nacquire - lbefore[i].nacquire,
+                   lafter[i].nspin - lbefore[i].nspin);
+    }
+    exit();
+}
@@ -0,0 +1,9 @@
+// Per-cpu page magazine counters returned by kallocstat(),
+// one entry per cpu (NCPU entries).
+struct kallocstat {
+  uint hit;           // kalloc() served from the cpu's magazine
+  uint miss;          // kalloc() that refilled it from the global list
+  uint spill;         // kfree() batches returned to the global list
+  uint drain;         // Pages kalloc() took from other cpus' magazines
+  uint cached;        // Pages in the magazine now
+};
@@ -113,6 +113,33 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send interrupt vector to the cpu with the given APIC ID.
+// Callers must have interrupts disabled, since the two ICR
+// writes must not be split by another IPI from this cpu.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
+// Stop (on == 0) or restart this cpu's periodic timer
+// interrupt.  Used to keep idle cpus from waking every tick.
+void
+lapictimer(int on)
+{
+  if(!lapic)
+    return;
+  if(on)
+    lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
+  else
+    lapicw(TIMER, MASKED | PERIODIC | (T_IRQ0 + IRQ_TIMER));
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
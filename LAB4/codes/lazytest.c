@@ -0,0 +1,52 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define BIG (16 * 1024 * 1024)
+
+// Usage: lazytest
+// Grows the heap by BIG bytes, which should be nearly free
+// now that pages are only mapped on first touch, then checks
+// that untouched pages read as zero, that fork copes with the
+// unmapped pages, and that system calls can read and write
+// heap memory the process itself never touched.
+int main(int argc, char *argv[]) {
+    char *heap, buf[8];
+    int t0, fds[2], bad = 0;
+
+    t0 = uptime();
+    heap = sbrk(BIG);
+    if(heap == (char*)-1) {
+        printf(1, "lazytest: sbrk failed\n");
+        exit();
+    }
+    printf(1, "sbrk(%d) took %d ticks\n", BIG, uptime() - t0);
+
+    for(int i = 0; i < BIG; i += 64 * 4096) {
+        if(heap[i] != 0)
+            bad = 1;
+        heap[i] = 'x';
+    }
+    printf(1, "sparse touch: %s\n", bad ? "FAILED, page not zero" : "ok");
+
+    if(fork() == 0) {
+        bad = heap[0] != 'x' || heap[4096] != 0;
+        heap[BIG - 1] = 'y';
+        printf(1, "child view of heap: %s\n", bad ? "FAILED" : "ok");
+        exit();
+    }
+    wait();
+
+    // The kernel writes into, and reads from, untouched pages.
+    pipe(fds);
+    write(fds[1], "lazy", 4);
+    if(read(fds[0], heap + 2 * 4096, 4) != 4 || heap[2 * 4096 + 3] != 'y')
+        bad = 1;
+    if(write(fds[1], heap + 5 * 4096, 4) != 4 ||
+       read(fds[0], buf, 4) != 4 || buf[0] != 0)
+        bad = 1;
+    printf(1, "syscalls on untouched pages: %s\n", bad ? "FAILED" : "ok");
+
+    sbrk(-BIG);
+    exit();
+}
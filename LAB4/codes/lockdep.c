@@ -0,0 +1,240 @@
+// Lock dependency validator.
+//
+// Records, for every pair of lock classes (see lockclass() in
+// spinlock.c), whether a lock of one class has been acquired
+// while a lock of the other was held.  A new dependency that
+// closes a cycle in that graph means two code paths take
+// locks in opposite orders and can deadlock, even if they
+// never happened to race; lockdep prints the cycle, with the
+// call stacks that first created each dependency, and stops
+// checking.
+//
+// Spinlocks are tracked per cpu, since a cpu cannot switch
+// processes while holding one.  Sleeplocks, rwlocks and plocks
+// are tracked per process.  Locks of the same class nested
+// inside each other (two proc locks, two run queues) are not
+// checked.
+
+#ifdef LOCKDEP
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "lockstat.h"
+#include "lockdep.h"
+
+#define NHELD  16   // Locks one cpu or process can hold at once
+#define NDEPPC 6    // Return addresses kept per dependency
+
+struct held {
+  void *lk;
+  int class;
+  uint *pcs;        // Holder's call stack, if the lock keeps one
+};
+
+struct heldstack {
+  struct held h[NHELD];
+  int n;
+};
+
+static struct heldstack cpuheld[NCPU];
+static struct heldstack procheld[NPROC];
+
+static uint dep[NLOCKCLASS];   // dep[a] bit b: b taken while holding a
+static uint deppc[NLOCKCLASS][NLOCKCLASS][NDEPPC];
+static uint graphlock;
+static volatile int disabled;
+
+static void
+printpcs(uint *pcs, int n)
+{
+  int i;
+
+  for(i = 0; i < n && pcs[i]; i++)
+    cprintf(" %p", pcs[i]);
+  cprintf("\n");
+}
+
+// Print the dependency chain from class from to class to,
+// found by breadth-first search, and return 1; or return 0
+// if to cannot be reached.  Caller holds graphlock.
+static int
+findpath(int from, int to, int *path)
+{
+  int q[NLOCKCLASS], prev[NLOCKCLASS];
+  int head = 0, tail = 0, a, b, n;
+  uint seen = 1 << from;
+
+  q[tail++] = from;
+  while(head < tail){
+    a = q[head++];
+    for(b = 0; b < NLOCKCLASS; b++){
+      if(!(dep[a] & (1 << b)) || (seen & (1 << b)))
+        continue;
+      seen |= 1 << b;
+      prev[b] = a;
+      if(b == to){
+        // Unwind into path[], from first to last.
+        for(n = 0, a = b; a != from; a = prev[a])
+          n++;
+        path[n] = to;
+        for(a = n; a > 0; a--)
+          path[a-1] = prev[path[a]];
+        return n + 1;
+      }
+      q[tail++] = b;
+    }
+  }
+  return 0;
+}
+
+static void
+report(struct held *h, int class, uint *pcs, int *path, int n)
+{
+  int i;
+
+  cprintf("lockdep: possible deadlock: acquiring %s while holding %s\n",
+          lockclassname(class), lockclassname(h->class));
+  cprintf("  acquired at:");
+  printpcs(pcs, NDEPPC);
+  if(h->pcs){
+    cprintf("  %s held from:", lockclassname(h->class));
+    printpcs(h->pcs, 10);
+  }
+  cprintf("  but the opposite order was seen before:\n");
+  for(i = 0; i+1 < n; i++){
+    cprintf("  %s -> %s at:", lockclassname(path[i]), lockclassname(path[i+1]));
+    printpcs(deppc[path[i]][path[i+1]], NDEPPC);
+  }
+}
+
+// Record that class is being acquired while holding every
+// lock on s, and check for cycles.  Interrupts are off.
+static void
+adddeps(struct heldstack *s, int class, uint *pcs)
+{
+  struct held *h;
+  int path[NLOCKCLASS], n;
+
+  for(h = s->h; h < s->h+s->n; h++){
+    if(h->class == class || h->class == 0 || (dep[h->class] & (1 << class)))
+      continue;
+    while(xchg(&graphlock, 1) != 0)
+      ;
+    if(!(dep[h->class] & (1 << class))){
+      if((n = findpath(class, h->class, path)) != 0){
+        disabled = 1;
+        xchg(&graphlock, 0);
+        report(h, class, pcs, path, n);
+        return;
+      }
+      memmove(deppc[h->class][class], pcs, sizeof(deppc[0][0]));
+      dep[h->class] |= 1 << class;
+    }
+    xchg(&graphlock, 0);
+  }
+}
+
+static void
+push(struct heldstack *s, void *lk, int class, uint *pcs)
+{
+  if(s->n == NHELD){
+    disabled = 1;
+    cprintf("lockdep: more than %d locks held, giving up\n", NHELD);
+    return;
+  }
+  s->h[s->n].lk = lk;
+  s->h[s->n].class = class;
+  s->h[s->n].pcs = pcs;
+  s->n++;
+}
+
+// Locks need not be released in the order they were taken.
+static void
+pop(struct heldstack *s, void *lk)
+{
+  int i;
+
+  for(i = s->n - 1; i >= 0; i--){
+    if(s->h[i].lk == lk){
+      s->n--;
+      for(; i < s->n; i++)
+        s->h[i] = s->h[i+1];
+      return;
+    }
+  }
+}
+
+// Check lk against everything this cpu and process hold,
+// then push it on s.  Interrupts are off.
+static void
+check(void *lk, int class, uint *pcs, struct heldstack *s, uint *holderpcs)
+{
+  struct proc *p = myproc();
+
+  if(class == 0)
+    return;
+  adddeps(&cpuheld[cpuid()], class, pcs);
+  if(p && !disabled)
+    adddeps(&procheld[p - ptable.proc], class, pcs);
+  if(!disabled)
+    push(s, lk, class, holderpcs);
+}
+
+// Called by acquire() with interrupts off, before spinning.
+void
+lockdep_acquire(struct spinlock *lk)
+{
+  uint pcs[10];
+
+  if(disabled)
+    return;
+  getcallerpcs(&lk, pcs);
+  check(lk, lk->class, pcs, &cpuheld[cpuid()], lk->pcs);
+}
+
+void
+lockdep_release(struct spinlock *lk)
+{
+  if(!disabled)
+    pop(&cpuheld[cpuid()], lk);
+}
+
+// Called before a process may block for a sleeplock, rwlock
+// or plock of the given class.
+void
+lockdep_acquiresleep(void *lk, int class)
+{
+  uint pcs[10];
+
+  pushcli();
+  if(!disabled){
+    getcallerpcs(&lk, pcs);
+    check(lk, class, pcs, &procheld[myproc() - ptable.proc], 0);
+  }
+  popcli();
+}
+
+void
+lockdep_releasesleep(void *lk)
+{
+  pushcli();
+  if(!disabled)
+    pop(&procheld[myproc() - ptable.proc], lk);
+  popcli();
+}
+
+// A proc slot is being reused.  Its last process may have
+// exited or been killed holding sleeplocks or plocks.
+void
+lockdep_procinit(struct proc *p)
+{
+  procheld[p - ptable.proc].n = 0;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef __LOCKDEP_H__
+#define __LOCKDEP_H__
+
+// Lock-order validator, built in with "make LOCKDEP=1".
+// Otherwise these hooks compile to nothing.
+#ifdef LOCKDEP
+void lockdep_acquire(struct spinlock*);
+void lockdep_release(struct spinlock*);
+void lockdep_acquiresleep(void*, int);
+void lockdep_releasesleep(void*);
+void lockdep_procinit(struct proc*);
+#else
+#define lockdep_acquire(lk)              do { } while(0)
+#define lockdep_release(lk)              do { } while(0)
+#define lockdep_acquiresleep(lk, class)  do { } while(0)
+#define lockdep_releasesleep(lk)         do { } while(0)
+#define lockdep_procinit(p)              do { } while(0)
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+#include "types.h"
+#include "stat.h"
+#include "lockstat.h"
+#include "user.h"
+
+struct lockstat before[NLOCKCLASS], after[NLOCKCLASS];
+
+// Usage: lockstat [command [args...]]
+// Runs the command (if any) and prints per-lock statistics
+// for the run, sorted by spins.  Max hold and max wait are
+// since boot, in TSC cycles.
+int main(int argc, char *argv[]) {
+    int n, order[NLOCKCLASS];
+
+    memset(before, 0, sizeof(before));
+    if(argc > 1) {
+        getlockstats(before, NLOCKCLASS);
+        int pid = fork();
+        if(pid < 0) {
+            printf(2, "lockstat: fork failed\n");
+            exit();
+        }
+        if(pid == 0) {
+            exec(argv[1], argv + 1);
+            printf(2, "lockstat: exec %s failed\n", argv[1]);
+            exit();
+        }
+        wait();
+    }
+    n = getlockstats(after, NLOCKCLASS);
+    if(n < 0) {
+        printf(2, "lockstat: getlockstats failed\n");
+        exit();
+    }
+
+    // Classes created during the run have no "before" entry.
+    for(int i = 0; i < n; i++) {
+        if(strcmp(before[i].name, after[i].name) == 0) {
+            after[i].nacquire -= before[i].nacquire;
+            after[i].nspin -= before[i].nspin;
+        }
+        order[i] = i;
+    }
+    for(int i = 0; i < n; i++) {
+        for(int j = i + 1; j < n; j++) {
+            if(after[order[j]].nspin > after[order[i]].nspin) {
+                int t = order[i];
+                order[i] = order[j];
+                order[j] = t;
+            }
+        }
+    }
+
+    printf(1, "lock\t\tacquires\tspins\tmaxhold\tmaxwait\n");
+    for(int i = 0; i < n; i++) {
+        struct lockstat *s = &after[order[i]];
+        if(s->nacquire == 0)
+            continue;
+        printf(1, "%s\t%s%d\t\t%d\t%d\t%d\n", s->name,
+               strlen(s->name) < 8 ? "\t" : "",
+               s->nacquire, s->nspin, s->maxhold, s->maxwait);
+    }
+    if(n > 0 && after[order[0]].nspin > 0)
+        printf(1, "hottest: %s\n", after[order[0]].name);
+    exit();
+}
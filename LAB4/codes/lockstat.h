@@ -0,0 +1,12 @@
+#define NLOCKCLASS 32   // Lock classes, one per lock name
+
+// Statistics for all locks sharing a name, summed over
+// all cpus and returned by getlockstats().  Times are in
+// TSC cycles.
+struct lockstat {
+  char name[16];
+  uint nacquire;      // Acquisitions
+  uint nspin;         // Failed xchg attempts while waiting
+  uint maxhold;       // Longest time held
+  uint maxwait;       // Longest time spent waiting to acquire
+};
@@ -1,6 +1,7 @@
 #include "types.h"
 #include "user.h"
 #include "stat.h"
+#include "lockstat.h"
 
 #define NCPU 8 
 #define ITERATIONS 300  
@@ -23,13 +24,33 @@ worker(int i)
   exit();
 }
 
+// Print acquisitions and spins for a lock class since the
+// snapshot in before[].
+void
+report(char *name, struct lockstat *before, struct lockstat *after, int n)
+{
+  for(int i = 0; i < n; i++){
+    if(strcmp(after[i].name, name) != 0)
+      continue;
+    uint acq = after[i].nacquire - before[i].nacquire;
+    uint spins = after[i].nspin - before[i].nspin;
+    printf(1, "%s: %d acquires, %d spins, %d spins/acquire, max wait %d cycles\n",
+           name, acq, spins, acq ? spins / acq : 0, after[i].maxwait);
+  }
+}
+
+struct lockstat before[NLOCKCLASS], after[NLOCKCLASS];
+
 int
 main(int argc, char *argv[])
 {
   uint scores[NCPU];
+  int n, start;
 
   printf(1, "Starting AGGRESSIVE Lock Contention Test on ptable.lock...\n");
 
+  getlockstats(before, NLOCKCLASS);
+  start = uptime();
   getlockstat(scores);
   printf(1, "Initial Stats (Avg Spins/Acquire):\n");
   for(int i = 0; i < NCPU; i++) {
@@ -60,5 +81,10 @@ main(int argc, char *argv[])
     printf(1, "CPU %d: Score: %d\n", i, scores[i]);
   }
 
+  n = getlockstats(after, NLOCKCLASS);
+  printf(1, "\nThis run (%d ticks):\n", uptime() - start);
+  report("ptable", before, after, n);
+  report("bcache", before, after, n);
+
   exit();
 }
\ No newline at end of file
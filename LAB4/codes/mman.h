@@ -0,0 +1,9 @@
+// mmap() protection and flags.
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+
+#define MAP_SHARED  0x01   // Changes are shared and written back to the file
+#define MAP_PRIVATE 0x02   // Changes are private to the process
+#define MAP_ANON    0x20   // No file: zero-filled memory
+
+#define MAP_FAILED  ((void*)-1)
@@ -0,0 +1,120 @@
+#include "types.h"
+#include "stat.h"
+#include "fcntl.h"
+#include "mman.h"
+#include "user.h"
+#include "ulock.h"
+
+#define TMP "mmaptmp"
+#define ITERS 1000
+
+// Usage: mmaptest [file]
+// Maps file (README by default) and counts its lines in
+// place, with no copy through read(); shares an anonymous
+// counter, and a futex mutex guarding another, between a
+// parent and its children; and checks that
+// stores to a MAP_SHARED file mapping reach the file after
+// munmap(), and that shmalloc() does not map over a mapping.
+int main(int argc, char *argv[]) {
+    char *p, *name, buf[16];
+    struct stat st;
+    int fd, t0, lines, bad, n, *counter;
+    struct { struct umutex m; int n; } *locked;
+
+    name = argc > 1 ? argv[1] : "README";
+    if((fd = open(name, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        printf(1, "mmaptest: cannot open %s\n", name);
+        exit();
+    }
+    t0 = uptime();
+    p = mmap(0, st.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        printf(1, "mmaptest: mmap %s failed\n", name);
+        exit();
+    }
+    lines = 0;
+    for(int i = 0; i < st.size; i++)
+        if(p[i] == '\n')
+            lines++;
+    printf(1, "%s: %d bytes, %d lines, scanned in %d ticks\n",
+           name, st.size, lines, uptime() - t0);
+    if(munmap(p, st.size) < 0)
+        printf(1, "munmap failed\n");
+
+    counter = mmap(0, sizeof(int), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if(counter == MAP_FAILED) {
+        printf(1, "mmaptest: anonymous mmap failed\n");
+        exit();
+    }
+    for(int i = 0; i < 4; i++) {
+        if(fork() == 0) {
+            __sync_fetch_and_add(counter, 1);
+            exit();
+        }
+    }
+    for(int i = 0; i < 4; i++)
+        wait();
+    printf(1, "shared anonymous counter: %s\n", *counter == 4 ? "ok" : "FAILED");
+    munmap(counter, sizeof(int));
+
+    locked = mmap(0, sizeof(*locked), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    if(locked == MAP_FAILED) {
+        printf(1, "mmaptest: anonymous mmap failed\n");
+        exit();
+    }
+    for(int i = 0; i < 4; i++) {
+        if(fork() == 0) {
+            for(int j = 0; j < ITERS; j++) {
+                umutex_lock(&locked->m);
+                locked->n++;
+                umutex_unlock(&locked->m);
+            }
+            exit();
+        }
+    }
+    for(int i = 0; i < 4; i++)
+        wait();
+    printf(1, "futex mutex in a mapping: %s\n", locked->n == 4 * ITERS ? "ok" : "FAILED");
+    munmap(locked, sizeof(*locked));
+
+    if((fd = open(TMP, O_CREATE|O_RDWR)) < 0) {
+        printf(1, "mmaptest: cannot create %s\n", TMP);
+        exit();
+    }
+    write(fd, "................", 16);
+    p = mmap(0, 16, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        printf(1, "mmaptest: shared file mmap failed\n");
+        exit();
+    }
+    for(int i = 0; i < 16; i++)
+        p[i] = 'a' + i;
+    munmap(p, 16);
+    bad = 1;
+    if((fd = open(TMP, O_RDONLY)) >= 0) {
+        bad = read(fd, buf, 16) != 16;
+        for(int i = 0; i < 16; i++)
+            if(buf[i] != 'a' + i)
+                bad = 1;
+        close(fd);
+    }
+    unlink(TMP);
+    printf(1, "shared file writeback: %s\n", bad ? "FAILED" : "ok");
+
+    // Grow the heap (lazily) up to a touched mapping: shmalloc
+    // must refuse to map over it.
+    p = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if(p == MAP_FAILED) {
+        printf(1, "mmaptest: anonymous mmap failed\n");
+        exit();
+    }
+    p[0] = 'm';
+    n = p - sbrk(0);
+    bad = sbrk(n) == (char*)-1 || shmalloc(4096) != (void*)-1 || p[0] != 'm';
+    sbrk(-n);
+    munmap(p, 4096);
+    printf(1, "shmalloc next to a mapping: %s\n", bad ? "FAILED" : "ok");
+    exit();
+}
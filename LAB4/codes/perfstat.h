@@ -0,0 +1,11 @@
+// Throughput counters returned by end_measure(): the sum over
+// all cpus of each per-cpu counter since start_measure().
+struct perfstat {
+  uint ticks;         // Elapsed ticks
+  uint nexit;         // Processes that finished
+  uint nfork;         // Processes created
+  uint nswitch;       // Context switches into a process
+  uint nsyscall;      // System calls
+  uint busyticks;     // Cpu ticks spent running a process
+  uint idleticks;     // Cpu ticks spent halted in idle()
+};
@@ -7,6 +7,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "waitq.h"
 
 #define PIPESIZE 512
 
@@ -17,6 +18,8 @@ struct pipe {
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  struct waitq rwait;  // readers waiting for data
+  struct waitq wwait;  // writers waiting for room
 };
 
 int
@@ -34,6 +37,8 @@ pipealloc(struct file **f0, struct file **f1)
   p->writeopen = 1;
   p->nwrite = 0;
   p->nread = 0;
+  p->rwait.head = p->rwait.tail = 0;
+  p->wwait.head = p->wwait.tail = 0;
   initlock(&p->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -62,10 +67,10 @@ pipeclose(struct pipe *p, int writable)
   acquire(&p->lock);
   if(writable){
     p->writeopen = 0;
-    wakeup(&p->nread);
+    wakeall(&p->rwait);
   } else {
     p->readopen = 0;
-    wakeup(&p->nwrite);
+    wakeall(&p->wwait);
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
@@ -87,12 +92,12 @@ pipewrite(struct pipe *p, char *addr, int n)
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
-      sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+      wakeall(&p->rwait);
+      sleepq(&p->wwait, &p->lock);  //DOC: pipewrite-sleep
     }
     p->data[p->nwrite++ % PIPESIZE] = addr[i];
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  wakeall(&p->rwait);  //DOC: pipewrite-wakeup1
   release(&p->lock);
   return n;
 }
@@ -108,14 +113,14 @@ piperead(struct pipe *p, char *addr, int n)
       release(&p->lock);
       return -1;
     }
-    sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+    sleepq(&p->rwait, &p->lock); //DOC: piperead-sleep
   }
   for(i = 0; i < n; i++){  //DOC: piperead-copy
     if(p->nread == p->nwrite)
       break;
     addr[i] = p->data[p->nread++ % PIPESIZE];
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  wakeall(&p->wwait);  //DOC: piperead-wakeup
   release(&p->lock);
   return i;
 }
@@ -7,120 +7,114 @@
 #include "proc.h"
 #include "spinlock.h"
 #include "plock.h"
- 
-struct plock_node node_pool[NPROC];
-struct spinlock pool_lock;
- 
-struct plock_node*
-alloc_node(void)
+#include "lockdep.h"
+
+void
+plock_init(struct plock *pl, char *name)
 {
-  acquire(&pool_lock);
-  for(int i = 0; i < NPROC; i++){
-    if(node_pool[i].active == 0){
-      node_pool[i].active = 1;
-      release(&pool_lock);
-      return &node_pool[i];
-    }
-  }
-  release(&pool_lock);
-  panic("plock: out of nodes"); 
-  return 0;
+  initlock(&pl->lk, "plock_lk");
+  pl->name = name;
+  pl->class = lockclass(name);
+  pl->locked = 0;
+  pl->owner = 0;
+  pl->nwait = 0;
+  pl->seq = 0;
 }
 
-void
-free_node(struct plock_node *n)
+// Does waiter a go before waiter b?  Higher priority first,
+// then first come first served.
+static int
+before(struct plock_node *a, struct plock_node *b)
 {
-  acquire(&pool_lock);
-  n->active = 0;
-  n->proc = 0;
-  n->next = 0;
-  release(&pool_lock);
+  if(a->priority != b->priority)
+    return a->priority > b->priority;
+  return (int)(a->seq - b->seq) < 0;
 }
 
- 
-void
-plock_init(struct plock *pl, char *name)
+static void
+heappush(struct plock *pl, struct plock_node *n)
 {
-  initlock(&pl->lk, "plock_lk");  
-  initlock(&pool_lock, "pool_lk");  
-  pl->name = name;
-  pl->locked = 0;
-  pl->head = 0;
-  
- 
-  for(int i = 0; i < NPROC; i++)
-    node_pool[i].active = 0;
+  int i = pl->nwait++;
+
+  while(i > 0 && before(n, pl->heap[(i-1)/2])){
+    pl->heap[i] = pl->heap[(i-1)/2];
+    i = (i-1)/2;
+  }
+  pl->heap[i] = n;
+}
+
+static struct plock_node*
+heappop(struct plock *pl)
+{
+  struct plock_node *top = pl->heap[0], *last;
+  int i = 0, c;
+
+  last = pl->heap[--pl->nwait];
+  for(;;){
+    c = 2*i + 1;
+    if(c >= pl->nwait)
+      break;
+    if(c+1 < pl->nwait && before(pl->heap[c+1], pl->heap[c]))
+      c++;
+    if(!before(pl->heap[c], last))
+      break;
+    pl->heap[i] = pl->heap[c];
+    i = c;
+  }
+  pl->heap[i] = last;
+  return top;
 }
 
- 
 void
 plock_acquire(struct plock *pl, int priority)
 {
-  acquire(&pl->lk);  
+  struct proc *p = myproc();
+  struct plock_node *n = &p->pnode;
 
-  if(pl->locked == 0) {
- 
+  lockdep_acquiresleep(pl, pl->class);
+  acquire(&pl->lk);
+  if(pl->locked == 0){
     pl->locked = 1;
+    pl->owner = p;
+    p->npilocks++;
     release(&pl->lk);
-  } else {
- 
-    struct plock_node *n = alloc_node();
-    n->proc = myproc();
-    n->priority = priority;
-  
-    n->next = pl->head;
-    pl->head = n;
- 
-    sleep(n, &pl->lk); 
- 
-    
-    free_node(n); 
-    release(&pl->lk);
+    return;
   }
+
+  n->proc = p;
+  n->priority = priority;
+  n->seq = pl->seq++;
+  heappush(pl, n);
+  p->waitowner = &pl->owner;
+  piboost(pl->owner, priority);
+
+  // plock_release() makes us the owner before waking us.
+  while(pl->owner != p)
+    sleep(n, &pl->lk);
+  p->waitowner = 0;
+  p->npilocks++;
+  release(&pl->lk);
 }
 
- 
 void
 plock_release(struct plock *pl)
 {
-  acquire(&pl->lk);
+  struct plock_node *n;
 
-  if(pl->head == 0){
- 
+  lockdep_releasesleep(pl);
+  acquire(&pl->lk);
+  if(pl->nwait == 0){
     pl->locked = 0;
+    pl->owner = 0;
   } else {
- 
-    struct plock_node *max_node = 0;
-    struct plock_node *prev = 0;
-    
-    struct plock_node *curr = pl->head;
-    struct plock_node *prev_curr = 0;
-    
-    struct plock_node *max_prev = 0;
-    int max_prio = -1;  
-
-   
-    while(curr != 0){
-      if(curr->priority > max_prio){
-        max_prio = curr->priority;
-        max_node = curr;
-        max_prev = prev_curr;
-      }
-      prev_curr = curr;
-      curr = curr->next;
-    }
-
- 
-    if(max_prev == 0){
-      pl->head = max_node->next;  
-    } else {
-      max_prev->next = max_node->next; 
-    }
-
- 
-    
-    wakeup(max_node);  
+    // Hand the lock straight to the best waiter, which
+    // inherits from the waiters left behind.
+    n = heappop(pl);
+    pl->owner = n->proc;
+    if(pl->nwait > 0)
+      piboost(n->proc, pl->heap[0]->priority);
+    wakeproc(n->proc, n);
   }
-
+  pidrop();
   release(&pl->lk);
-}
\ No newline at end of file
+}
@@ -2,19 +2,25 @@
 #define __PLOCK_H__
 
 #include "spinlock.h"
- 
+#include "param.h"
+
+// Waiter node, embedded in each struct proc: a process
+// waits for at most one plock at a time.
 struct plock_node {
-  struct proc *proc;    
-  int priority;          
-  struct plock_node *next;  
-  int active;           
+  struct proc *proc;
+  int priority;
+  uint seq;              // Arrival order, breaks priority ties
 };
 
 struct plock {
-  struct spinlock lk;    
-  int locked;           
-  struct plock_node *head;  
-  char *name;             
+  struct spinlock lk;
+  int locked;
+  struct proc *owner;    // Current holder
+  struct plock_node *heap[NPROC];  // Waiters, highest priority first
+  int nwait;
+  uint seq;              // Next arrival number
+  char *name;
+  int class;             // Lock class of name, for lockdep
 };
 
-#endif
\ No newline at end of file
+#endif
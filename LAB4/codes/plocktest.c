@@ -1,6 +1,16 @@
 #include "types.h"
 #include "user.h"
 
+#define NHOG 6
+#define HOGWORK 100000000
+#define HOLDWORK 20000000
+
+void spin(int n) {
+    volatile int x = 0;
+    for(int i = 0; i < n; i++)
+        x++;
+}
+
 void worker(int priority) {
     printf(1, "Child (pid: %d) requesting lock with priority %d\n", getpid(), priority);
     plock_acquire(priority);
@@ -10,6 +20,52 @@ void worker(int priority) {
     exit();
 }
 
+// Priority inversion: a low-priority holder that is younger
+// than a crowd of CPU hogs (so FCFS puts it behind them) and
+// a high-priority waiter (us).  Returns how long we waited.
+int inversion(int pi) {
+    int go[2], ready[2], t0, waited;
+    char c;
+
+    setpi(pi);
+    pipe(go);
+    pipe(ready);
+
+    for(int i = 0; i < NHOG; i++) {
+        if(fork() == 0) {
+            close(go[1]);
+            read(go[0], &c, 1);
+            spin(HOGWORK);
+            exit();
+        }
+    }
+    if(fork() == 0) {
+        close(go[1]);
+        plock_acquire(1);
+        write(ready[1], "x", 1);
+        read(go[0], &c, 1);
+        spin(HOLDWORK);
+        plock_release();
+        exit();
+    }
+
+    // Holder has the lock; start everyone at once.
+    read(ready[0], &c, 1);
+    close(go[0]);
+    close(go[1]);
+
+    t0 = uptime();
+    plock_acquire(100);
+    waited = uptime() - t0;
+    plock_release();
+
+    for(int i = 0; i < NHOG + 1; i++)
+        wait();
+    close(ready[0]);
+    close(ready[1]);
+    return waited;
+}
+
 int main() {
     printf(1, "Starting Priority Lock Test...\n");
  
@@ -29,5 +85,14 @@ int main() {
     plock_release();
  
     wait(); wait(); wait();
+
+    printf(1, "\nPriority inversion: holder behind %d CPU hogs\n", NHOG);
+    int old = setsteal(0);
+    int off = inversion(0);
+    printf(1, "PI off: priority 100 waiter blocked %d ticks\n", off);
+    int on = inversion(1);
+    printf(1, "PI on:  priority 100 waiter blocked %d ticks\n", on);
+    setsteal(old);
+    setpi(1);
     exit();
 }
\ No newline at end of file
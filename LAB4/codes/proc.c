@@ -4,13 +4,27 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
+#include "mman.h"
 #include "spinlock.h"
+#include "lockdep.h"
+#include "perfstat.h"
+#include "waitq.h"
 
 
-uint start_ticks = 0;      
-int total_finished_procs = 0;  
+static struct perfstat measure_base;  // Counters at start_measure()
 int measuring_active = 0;
+int steal_enabled = 1;     // Idle cpus take work from other queues
+int pi_enabled = 1;        // Lock holders inherit waiters' priority
+
+// Time slice in ticks for each core class.  0 means the class
+// never preempts: P-cores are FCFS and a process keeps the
+// core until it blocks or exits.
+int quantum[] = {
+[CORE_E]  3,
+[CORE_P]  0,
+};
 
 
 struct ptable ptable;
@@ -21,12 +35,17 @@ int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-static void wakeup1(void *chan);
-
 void
 pinit(void)
 {
-  initlock(&ptable.lock, "ptable");
+  struct proc *p;
+  struct cpu *c;
+
+  initqlock(&ptable.lock, "ptable");
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    initlock(&p->lock, "proc");
+  for(c = cpus; c < cpus+ncpu; c++)
+    initlock(&c->rq.lock, "runq");
 }
 
 // Must be called with interrupts disabled
@@ -68,6 +87,313 @@ myproc(void) {
   return p;
 }
 
+//PAGEBREAK: 32
+// Choose the run queue for p: the shortest queue among the
+// cores of p's preferred class.
+static struct cpu*
+pickcpu(struct proc *p)
+{
+  struct cpu *c, *best;
+  int type;
+
+  if(ncpu == 1)
+    return &cpus[0];
+
+  type = p->core_pref;
+  best = 0;
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->core_type != type)
+      continue;
+    if(best == 0 || c->rq.len < best->rq.len)
+      best = c;
+  }
+  if(best == 0)
+    best = &cpus[0];
+  return best;
+}
+
+// P-core heap order: processes boosted by priority
+// inheritance first, then oldest first, pid breaks ties
+// between processes created in the same tick.
+static int
+older(struct proc *a, struct proc *b)
+{
+  if(a->eprio != b->eprio)
+    return a->eprio > b->eprio;
+  if(a->ctime != b->ctime)
+    return a->ctime < b->ctime;
+  return a->pid < b->pid;
+}
+
+// Move p up the heap of rq from slot i.  Caller holds rq->lock.
+static void
+heapup(struct runq *rq, int i, struct proc *p)
+{
+  int parent;
+
+  for(; i > 0; i = parent){
+    parent = (i - 1) / 2;
+    if(!older(p, rq->heap[parent]))
+      break;
+    rq->heap[i] = rq->heap[parent];
+  }
+  rq->heap[i] = p;
+}
+
+// Add p to the heap of rq.  Caller holds rq->lock.
+static void
+heappush(struct runq *rq, struct proc *p)
+{
+  heapup(rq, rq->len, p);
+}
+
+// Remove and return the oldest process in the heap of rq,
+// which must not be empty.  Caller holds rq->lock.
+static struct proc*
+heappop(struct runq *rq)
+{
+  struct proc *top, *last;
+  int i, child, n;
+
+  top = rq->heap[0];
+  n = rq->len - 1;
+  last = rq->heap[n];
+  for(i = 0; (child = 2*i + 1) < n; i = child){
+    if(child + 1 < n && older(rq->heap[child+1], rq->heap[child]))
+      child++;
+    if(!older(rq->heap[child], last))
+      break;
+    rq->heap[i] = rq->heap[child];
+  }
+  rq->heap[i] = last;
+  return top;
+}
+
+// Send halted cpu c a wakeup IPI, unless another kick()
+// already claimed it by clearing its idle flag.  Returns 0
+// if c was not ours to wake.
+static int
+wake(struct cpu *c)
+{
+  if(!c->idle || !__sync_bool_compare_and_swap(&c->idle, 1, 0))
+    return 0;
+  lapicipi(c->apicid, T_IRQ0 + IRQ_WAKE);
+  return 1;
+}
+
+// Work was just queued on c.  If c is halted in idle(),
+// send it a wakeup IPI; otherwise, with stealing on, wake
+// some other halted cpu so the work doesn't wait for c.
+// Each halted cpu is woken once, so a burst of work wakes
+// a different cpu for each item.
+// Interrupts are off (the caller holds p->lock).
+static void
+kick(struct cpu *c)
+{
+  struct cpu *v;
+
+  // Pairs with the barrier in idle(): either we see the
+  // idle flag or the idle cpu sees the queued work.
+  __sync_synchronize();
+  if(wake(c) || !steal_enabled)
+    return;
+  for(v = cpus; v < cpus+ncpu; v++)
+    if(wake(v))
+      return;
+}
+
+// Put p on a run queue.  Caller must hold p->lock and
+// have just made p RUNNABLE.
+static void
+runqput(struct proc *p)
+{
+  struct cpu *c = pickcpu(p);
+  struct runq *rq = &c->rq;
+
+  acquire(&rq->lock);
+  if(c->core_type == CORE_P){
+    // FCFS: O(log n) insert keyed on creation time.
+    heappush(rq, p);
+  } else if(p->eprio > 0){
+    // Boosted by priority inheritance: jump the queue.
+    p->rq_next = rq->head;
+    rq->head = p;
+    if(rq->tail == 0)
+      rq->tail = p;
+  } else {
+    // Round robin: append at the tail.
+    p->rq_next = 0;
+    if(rq->tail)
+      rq->tail->rq_next = p;
+    else
+      rq->head = p;
+    rq->tail = p;
+  }
+  rq->len++;
+  p->rqcpu = c;
+  p->qtime = rdtsc();
+  release(&rq->lock);
+
+  kick(c);
+}
+
+// Take the next process off c's run queue, or return 0.
+static struct proc*
+runqget(struct cpu *c)
+{
+  struct runq *rq = &c->rq;
+  struct proc *p;
+
+  if(rq->len == 0)
+    return 0;
+  acquire(&rq->lock);
+  if(rq->len == 0){
+    release(&rq->lock);
+    return 0;
+  }
+  if(c->core_type == CORE_P){
+    p = heappop(rq);
+  } else {
+    p = rq->head;
+    rq->head = p->rq_next;
+    if(rq->head == 0)
+      rq->tail = 0;
+    p->rq_next = 0;
+  }
+  rq->len--;
+  p->rqcpu = 0;
+  release(&rq->lock);
+  return p;
+}
+
+// p's inherited priority just went up: move it to the front
+// of the run queue it is waiting on, if any.  Caller holds
+// p->lock.
+static void
+runqboost(struct proc *p)
+{
+  struct cpu *c = p->rqcpu;
+  struct runq *rq;
+  struct proc *prev;
+  int i;
+
+  if(c == 0)
+    return;
+  rq = &c->rq;
+  acquire(&rq->lock);
+  if(p->rqcpu != c){
+    // runqget() took it meanwhile.
+    release(&rq->lock);
+    return;
+  }
+  if(c->core_type == CORE_P){
+    for(i = 0; i < rq->len; i++)
+      if(rq->heap[i] == p){
+        heapup(rq, i, p);
+        break;
+      }
+  } else if(rq->head != p){
+    for(prev = rq->head; prev->rq_next != p; prev = prev->rq_next)
+      ;
+    prev->rq_next = p->rq_next;
+    if(rq->tail == p)
+      rq->tail = prev;
+    p->rq_next = rq->head;
+    rq->head = p;
+  }
+  release(&rq->lock);
+}
+
+// Called by an idle cpu: take a waiting process from the
+// busiest queue of c's own class first, so work stays on the
+// cores it prefers, then from the busiest queue of the other
+// class.  A stolen process goes back to its preferred class
+// the next time it is queued.
+static struct proc*
+runqsteal(struct cpu *c)
+{
+  struct cpu *v, *victim;
+  struct proc *p;
+  int pass, type;
+
+  for(pass = 0; pass < 2; pass++){
+    type = c->core_type;
+    if(pass == 1)
+      type = (type == CORE_E) ? CORE_P : CORE_E;
+    victim = 0;
+    for(v = cpus; v < cpus+ncpu; v++){
+      if(v == c || v->core_type != type || v->rq.len == 0)
+        continue;
+      if(victim == 0 || v->rq.len > victim->rq.len)
+        victim = v;
+    }
+    if(victim && (p = runqget(victim)) != 0){
+      c->nsteal++;
+      return p;
+    }
+  }
+  return 0;
+}
+
+// Is there a queued process that c could run?
+static int
+haswork(struct cpu *c)
+{
+  struct cpu *v;
+
+  if(c->rq.len)
+    return 1;
+  if(!steal_enabled)
+    return 0;
+  for(v = cpus; v < cpus+ncpu; v++)
+    if(v->rq.len)
+      return 1;
+  return 0;
+}
+
+// Nothing to run: halt until an interrupt arrives instead of
+// spinning on the run queues.  kick() sends a halted cpu a
+// wakeup IPI when work is queued for it, clearing c->idle
+// first; a cleared flag means we have been woken.  The lapic
+// timer is stopped meanwhile on every cpu but cpu 0, which
+// keeps ticks.
+static void
+idle(struct cpu *c)
+{
+  uint t0;
+
+  cli();
+  c->idle = 1;
+  __sync_synchronize();
+  if(!haswork(c) && c->idle){
+    if(c != &cpus[0])
+      lapictimer(0);
+    t0 = ticks;
+    // sti takes effect after hlt starts, so a wakeup
+    // IPI sent after the check above still wakes us.
+    asm volatile("sti; hlt");
+    cli();
+    c->idleticks += ticks - t0;
+    if(c != &cpus[0])
+      lapictimer(1);
+  }
+  c->idle = 0;
+}
+
+// Histogram bucket for a queue-to-run latency in TSC cycles.
+static int
+latbucket(uint64 cycles)
+{
+  uint64 k = cycles >> 10;
+  int b = 0;
+
+  while(k > 1 && b < NSCHEDHIST-1){
+    k >>= 1;
+    b++;
+  }
+  return b;
+}
+
 //PAGEBREAK: 32
 // Look in the process table for an UNUSED proc.
 // If found, change state to EMBRYO and initialize
@@ -78,22 +404,47 @@ allocproc(void)
 {
   struct proc *p;
   char *sp;
+  uint gen = 0;
+  int pending;
 
   acquire(&ptable.lock);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  // A slot freed by wait() may still be seen by a lockless
+  // pid lookup; skip it until its grace period is over.
+  for(;;){
+    pending = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+      if(p->state != UNUSED)
+        continue;
+      if(rcu_done(p->rcugen))
+        goto found;
+      gen = p->rcugen;
+      pending = 1;
+    }
+    release(&ptable.lock);
+    if(!pending)
+      return 0;
+    rcu_wait(gen);
+    acquire(&ptable.lock);
+  }
 
 found:
   p->state = EMBRYO;
-  p->pid = nextpid++;
   p->priority = 1;
-
- 
+  p->ctime = ticks;
+  acquire(&p->lock);
+  write_seqbegin(&p->statseq);
+  p->pid = nextpid++;
+  p->wait_time = 0;
+  p->run_time = 0;
+  p->nvcsw = 0;
+  p->nivcsw = 0;
+  write_seqend(&p->statseq);
+  release(&p->lock);
+  p->eprio = 0;
+  p->npilocks = 0;
+  p->waitowner = 0;
+  lockdep_procinit(p);
 
   release(&ptable.lock);
 
@@ -132,6 +483,7 @@ userinit(void)
   p = allocproc();
   
   initproc = p;
+  p->core_pref = CORE_E;
   if((p->pgdir = setupkvm()) == 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
@@ -152,11 +504,12 @@ userinit(void)
   // run this process. the acquire forces the above
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
-  acquire(&ptable.lock);
+  acquire(&p->lock);
 
   p->state = RUNNABLE;
+  runqput(p);
 
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 // Grow current process's memory by n bytes.
@@ -169,8 +522,13 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    // Pages are mapped on first touch; see lazyfault().
+    if(sz + n < sz || sz + n >= KERNBASE)
       return -1;
+    // Stop short of the mmap() regions.
+    if(vmaoverlap(curproc->vma, sz, sz + n))
+      return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -189,6 +547,13 @@ fork(void)
   int i, pid;
   struct proc *np;
   struct proc *curproc = myproc();
+  struct vma *v;
+
+  // Pages of MAP_SHARED regions must exist before parent
+  // and child can share them; see copyuvm().
+  for(v = curproc->vma; v < &curproc->vma[NVMA]; v++)
+    if((v->flags & MAP_SHARED) && uvmpopulate(v->start, v->end - v->start) < 0)
+      return -1;
 
   // Allocate process.
   if((np = allocproc()) == 0){
@@ -196,7 +561,7 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz, curproc->vma)) == 0){
     kfree(np->kstack);
     np->kstack = 0;
     np->state = UNUSED;
@@ -204,6 +569,9 @@ fork(void)
   }
   np->sz = curproc->sz;
   np->parent = curproc;
+  // init and the shell it starts stay on E-cores,
+  // everything else prefers P-cores.
+  np->core_pref = (curproc == initproc) ? CORE_E : CORE_P;
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -213,16 +581,19 @@ fork(void)
     if(curproc->ofile[i])
       np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
+  vmadup(np->vma, curproc->vma);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
 
   pid = np->pid;
 
-  acquire(&ptable.lock);
+  acquire(&np->lock);
 
+  mycpu()->nfork++;
   np->state = RUNNABLE;
+  runqput(np);
 
-  release(&ptable.lock);
+  release(&np->lock);
 
   return pid;
 }
@@ -240,10 +611,6 @@ exit(void)
   if(curproc == initproc)
     panic("init exiting");
 
-  if(measuring_active) {
-      total_finished_procs++;
-  }
-
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(curproc->ofile[fd]){
@@ -252,6 +619,8 @@ exit(void)
     }
   }
 
+  vmaclear(curproc->pgdir, curproc->vma);
+
   begin_op();
   iput(curproc->cwd);
   end_op();
@@ -260,19 +629,28 @@ exit(void)
   acquire(&ptable.lock);
 
   // Parent might be sleeping in wait().
-  wakeup1(curproc->parent);
+  wakeup(curproc->parent);
 
   // Pass abandoned children to init.
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->parent == curproc){
+      acquire(&p->lock);
+      write_seqbegin(&p->statseq);
       p->parent = initproc;
+      write_seqend(&p->statseq);
+      release(&p->lock);
       if(p->state == ZOMBIE)
-        wakeup1(initproc);
+        wakeup(initproc);
     }
   }
 
   // Jump into the scheduler, never to return.
+  // The parent can't look at us until ptable.lock is released,
+  // and can't free us until the scheduler releases curproc->lock.
+  acquire(&curproc->lock);
   curproc->state = ZOMBIE;
+  mycpu()->nexit++;
+  release(&ptable.lock);
   sched();
   panic("zombie exit");
 }
@@ -295,16 +673,22 @@ wait(void)
         continue;
       havekids = 1;
       if(p->state == ZOMBIE){
-        // Found one.
+        // Found one.  Its lock is held until it has
+        // switched off its kernel stack.
+        acquire(&p->lock);
         pid = p->pid;
         kfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
+        write_seqbegin(&p->statseq);
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
         p->state = UNUSED;
+        p->rcugen = rcu_retire();
+        write_seqend(&p->statseq);
+        release(&p->lock);
         release(&ptable.lock);
         return pid;
       }
@@ -325,85 +709,65 @@ wait(void)
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run
+//  - take the next process off this CPU's run queue,
+//      or steal one from another CPU if it is empty
 //  - swtch to start running that process
 //  - eventually that process transfers control
 //      via swtch back to the scheduler.
- 
-
+// E-core queues are round robin, P-core queues are
+// ordered by creation time (FCFS).
 void
 scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  uint64 now;
   c->proc = 0;
   
   for(;;){
- 
+    // Enable interrupts on this processor.
     sti();
+    rcu_quiescent(c);
 
-    struct proc *best_p = 0;
-    long long min_ctime = -1;
-
- 
-    acquire(&ptable.lock);
-    
-    if (c->core_type == CORE_E) {
- 
-        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-          if(p->state != RUNNABLE)
-            continue;
-
- 
-          if(ncpu > 1 && p->pid > 3) 
-             continue; 
- 
-
-          c->proc = p;
-          switchuvm(p);
-          p->state = RUNNING;
-          
-          p->tick_count = 0; 
-
-          swtch(&(c->scheduler), p->context);
-          switchkvm();
-          c->proc = 0;
-        }
-    } 
-    else {
- 
-        
-        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-          if(p->state != RUNNABLE)
-            continue;
-
-          // انتخاب بر اساس کمترین زمان ایجاد (ctime)
-          if(best_p == 0 || p->ctime < min_ctime){ 
-             best_p = p;
-             min_ctime = p->ctime;
-          }
-        }
-
-        if(best_p != 0){
-          p = best_p;
-          c->proc = p;
-          switchuvm(p);
-          p->state = RUNNING;
-
-          p->tick_count = 0;
-
-          swtch(&(c->scheduler), p->context);
-          switchkvm();
-          c->proc = 0;
-        }
+    if((p = runqget(c)) == 0 &&
+       (!steal_enabled || (p = runqsteal(c)) == 0)){
+      idle(c);
+      continue;
     }
 
-    release(&ptable.lock);
-
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: not runnable");
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    c->proc = p;
+    switchuvm(p);
+    write_seqbegin(&p->statseq);
+    p->state = RUNNING;
+    p->cpu = c - cpus;
+    p->tick_count = 0;
+    c->nswitch++;
+    now = rdtsc();
+    p->wait_time += now - p->qtime;
+    c->lathist[latbucket(now - p->qtime)]++;
+    p->qtime = now;
+    write_seqend(&p->statseq);
+
+    swtch(&(c->scheduler), p->context);
+    switchkvm();
+    write_seqbegin(&p->statseq);
+    p->run_time += rdtsc() - p->qtime;
+    write_seqend(&p->statseq);
+
+    // Process is done running for now.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
-// Enter scheduler.  Must hold only ptable.lock
+// Enter scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
@@ -416,8 +780,8 @@ sched(void)
   int intena;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&p->lock))
+    panic("sched p->lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
@@ -433,10 +797,16 @@ sched(void)
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  struct proc *p = myproc();
+
+  acquire(&p->lock);  //DOC: yieldlock
+  write_seqbegin(&p->statseq);
+  p->state = RUNNABLE;
+  p->nivcsw++;
+  write_seqend(&p->statseq);
+  runqput(p);
   sched();
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -445,8 +815,8 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding p->lock from scheduler.
+  release(&myproc()->lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -473,19 +843,21 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
+  // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
+  // Once we hold p->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // (wakeup locks p->lock),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  acquire(&p->lock);  //DOC: sleeplock1
+  release(lk);
+
   // Go to sleep.
   p->chan = chan;
+  write_seqbegin(&p->statseq);
   p->state = SLEEPING;
+  p->nvcsw++;
+  write_seqend(&p->statseq);
 
   sched();
 
@@ -493,32 +865,160 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = 0;
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  release(&p->lock);
+  acquire(lk);
 }
 
 //PAGEBREAK!
 // Wake up all processes sleeping on chan.
-// The ptable lock must be held.
-static void
-wakeup1(void *chan)
+// Must be called without any p->lock.
+void
+wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p == myproc())
+      continue;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      runqput(p);
+    }
+    release(&p->lock);
+  }
 }
 
-// Wake up all processes sleeping on chan.
+// Wake p if it is still asleep on chan.
 void
-wakeup(void *chan)
+wakeproc(struct proc *p, void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan){
+    p->state = RUNNABLE;
+    runqput(p);
+  }
+  release(&p->lock);
+}
+
+// Take p off wait queue wq.
+void
+waitqremove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp, *prev = 0;
+
+  for(pp = &wq->head; *pp; prev = *pp, pp = &(*pp)->wq_next){
+    if(*pp == p){
+      *pp = p->wq_next;
+      if(wq->tail == p)
+        wq->tail = prev;
+      break;
+    }
+  }
+  p->wq = 0;
+  p->wq_next = 0;
+}
+
+// Like sleep(), but queue on wq so that a wakeup only has to
+// look at the processes actually waiting.  lk must be held
+// and must be the lock that protects wq.
+void
+sleepq(struct waitq *wq, struct spinlock *lk)
+{
+  struct proc *p = myproc();
+
+  p->wq = wq;
+  p->wq_next = 0;
+  if(wq->tail)
+    wq->tail->wq_next = p;
+  else
+    wq->head = p;
+  wq->tail = p;
+
+  sleep(wq, lk);
+
+  // Still queued if kill() woke us.
+  if(p->wq == wq)
+    waitqremove(wq, p);
+}
+
+// Wake the oldest sleeper on wq and return it, or 0 if the
+// queue is empty.  Caller holds the lock protecting wq.
+struct proc*
+wakeone(struct waitq *wq)
+{
+  struct proc *p = wq->head;
+
+  if(p == 0)
+    return 0;
+  waitqremove(wq, p);
+  wakeproc(p, wq);
+  return p;
+}
+
+// Wake every sleeper on wq.  Caller holds the lock
+// protecting wq.
+void
+wakeall(struct waitq *wq)
+{
+  while(wakeone(wq))
+    ;
+}
+
+// Priority inheritance.  A process waiting for a plock or
+// sleep lock lends its priority to the holder, and on down
+// the chain if that holder is itself waiting for a lock.
+// Boosted processes go to the front of their run queue.
+// Walks the chain without the locks' spinlocks, so a boost
+// can land on a process that just let go; that only makes
+// it run a little earlier.
+void
+piboost(struct proc *p, int prio)
+{
+  int depth;
+
+  if(!pi_enabled || prio <= 0)
+    return;
+  for(depth = 0; p && depth < NPROC; depth++){
+    acquire(&p->lock);
+    if(p->eprio >= prio){
+      release(&p->lock);
+      break;
+    }
+    p->eprio = prio;
+    if(p->state == RUNNABLE)
+      runqboost(p);
+    release(&p->lock);
+    p = p->waitowner ? *p->waitowner : 0;
+  }
+}
+
+// The current process let go of a plock or sleep lock.
+// Drop its inherited priority once it holds none.
+void
+pidrop(void)
+{
+  struct proc *p = myproc();
+
+  if(p->npilocks > 0 && --p->npilocks > 0)
+    return;
+  acquire(&p->lock);
+  p->eprio = 0;
+  release(&p->lock);
+}
+
+// Should the current process give way to a boosted process
+// queued on this cpu?  Racy; checked on every timer tick.
+int
+needresched(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = myproc(), *q;
+
+  if(c->rq.len == 0)
+    return 0;
+  q = (c->core_type == CORE_P) ? c->rq.heap[0] : c->rq.head;
+  return q && q->eprio > p->eprio;
 }
 
 // Kill the process with the given pid.
@@ -529,18 +1029,29 @@ kill(int pid)
 {
   struct proc *p;
 
-  acquire(&ptable.lock);
+  // No ptable.lock: the slot cannot be reused while we are
+  // in the read section, but the process may be reaped, so
+  // check the pid again under p->lock.
+  rcu_read_lock();
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->pid == pid){
+      acquire(&p->lock);
+      if(p->pid != pid){
+        release(&p->lock);
+        break;
+      }
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
+      if(p->state == SLEEPING){
         p->state = RUNNABLE;
-      release(&ptable.lock);
+        runqput(p);
+      }
+      release(&p->lock);
+      rcu_read_unlock();
       return 0;
     }
   }
-  release(&ptable.lock);
+  rcu_read_unlock();
   return -1;
 }
 
@@ -582,42 +1093,80 @@ procdump(void)
 }
 
  
+// Copy p's identity and scheduling statistics without taking
+// any lock, retrying if the scheduler updates them meanwhile.
+// Returns 0, leaving ps zeroed, for an unused slot.
+int
+procsnap(struct proc *p, struct procstat *ps)
+{
+  struct proc *pp;
+  uint seq;
+
+  do {
+    seq = read_seqbegin(&p->statseq);
+    memset(ps, 0, sizeof(*ps));
+    if(p->state == UNUSED || p->state == EMBRYO)
+      continue;
+    pp = p->parent;
+    ps->pid = p->pid;
+    ps->ppid = pp ? pp->pid : 0;
+    ps->state = p->state;
+    ps->core_pref = p->core_pref;
+    safestrcpy(ps->name, p->name, sizeof(ps->name));
+    ps->wait_time = p->wait_time >> 10;
+    ps->run_time = p->run_time >> 10;
+    ps->nvcsw = p->nvcsw;
+    ps->nivcsw = p->nivcsw;
+  } while(read_seqretry(&p->statseq, seq));
+  return ps->pid;
+}
+
+// Sum the per-cpu counters.  Each cpu only bumps its own
+// counters, so no lock is needed; a sum taken while other
+// cpus run is at worst a few events stale.
+static void
+perfsum(struct perfstat *ps)
+{
+  struct cpu *c;
+
+  memset(ps, 0, sizeof(*ps));
+  ps->ticks = ticks;
+  for(c = cpus; c < cpus+ncpu; c++){
+    ps->nexit += c->nexit;
+    ps->nfork += c->nfork;
+    ps->nswitch += c->nswitch;
+    ps->nsyscall += c->nsyscall;
+    ps->busyticks += c->busyticks;
+    ps->idleticks += c->idleticks;
+  }
+}
+
 int
 start_measure(void)
 {
-  start_ticks = ticks;       
-  total_finished_procs = 0;   
-  measuring_active = 1;       
-  cprintf("Measurement Started at tick %d\n", start_ticks);
+  perfsum(&measure_base);
+  measuring_active = 1;
   return 0;
 }
 
- 
+// Fill *ps with the counter deltas since start_measure().
 int
-end_measure(void)
+end_measure(struct perfstat *ps)
 {
-  if(!measuring_active) {
-      cprintf("Error: Measurement was not started.\n");
-      return -1;
-  }
-  
-  uint current_ticks = ticks;
-  uint duration = current_ticks - start_ticks;
-  
-  measuring_active = 0;  
+  struct perfstat now;
 
- 
-  if(duration == 0) duration = 1;
-
- 
-  int throughput = (total_finished_procs * 1000) / duration;
-  
-  cprintf("\n--- Measurement Results ---\n");
-  cprintf("Total Time (ticks): %d\n", duration);
-  cprintf("Finished Processes: %d\n", total_finished_procs);
-  cprintf("Throughput: %d (scaled by 1000)\n", throughput); 
- 
-  
+  if(!measuring_active)
+    return -1;
+  measuring_active = 0;
+
+  perfsum(&now);
+  ps->ticks = now.ticks - measure_base.ticks;
+  ps->nexit = now.nexit - measure_base.nexit;
+  ps->nfork = now.nfork - measure_base.nfork;
+  ps->nswitch = now.nswitch - measure_base.nswitch;
+  ps->nsyscall = now.nsyscall - measure_base.nsyscall;
+  ps->busyticks = now.busyticks - measure_base.busyticks;
+  ps->idleticks = now.idleticks - measure_base.idleticks;
   return 0;
 }
 
@@ -635,7 +1184,7 @@ print_info(void)
   cprintf("Creation Time: %d\n", p->ctime);
   
  
-  cprintf("Lifetime: %d ticks\n", ticks - p->ctime);
+  cprintf("Lifetime: %d ticks\n", readticks() - p->ctime);
  
   pushcli(); 
   int core_type = mycpu()->core_type;  
@@ -3,6 +3,9 @@
 
 #include "spinlock.h"  
 #include "param.h"
+#include "schedstat.h"
+#include "plock.h"
+#include "seqlock.h"
 
 #define CORE_E 0  // Efficiency Core (Even CPUID)
 #define CORE_P 1  // Performance Core (Odd CPUID)
@@ -18,12 +21,29 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A region of user memory whose pages are filled on first
+// touch (see vmafault): the segments of the program exec()
+// started, and mmap() regions.  mmap() regions sit above the
+// heap, below KERNBASE.
+struct vma {
+  uint start;                  // Page-aligned first address
+  uint end;                    // One past the last address
+  struct inode *ip;            // File backing the region; 0 if anonymous
+  uint off;                    // File offset of start
+  uint filesz;                 // Bytes from the file; the rest are zero
+  int prot;                    // PROT_READ, PROT_WRITE
+  int flags;                   // MAP_SHARED or MAP_PRIVATE, MAP_ANON; 0 if slot free
+};
+
 struct proc {
+  struct spinlock lock;        // Protects state, chan and the context switch
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
   char *kstack;                // Bottom of kernel stack for this process
   enum procstate state;        // Process state
   int pid;                     // Process ID
+  uint rcugen;                 // rcu_retire() when freed; slot reusable
+                               // once rcu_done()
   int priority;
   struct proc *parent;         // Parent process
   struct trapframe *tf;        // Trap frame for current syscall
@@ -33,9 +53,39 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
-  uint ctime;               
+  uint ctime;                  // Tick at which the process was created
 
   int tick_count;              
+  struct proc *rq_next;        // Next process on a run queue
+  int cpu;                     // CPU that last ran this process
+  int core_pref;               // Core class to queue on (CORE_E or CORE_P)
+  struct seqlock statseq;      // Guards pid, parent, name and the stats below
+                               // for procsnap(); writers hold lock
+  uint64 qtime;                // TSC when last queued or last run
+  uint64 wait_time;            // TSC cycles spent RUNNABLE
+  uint64 run_time;             // TSC cycles spent RUNNING
+  uint nvcsw;                  // Voluntary context switches
+  uint nivcsw;                 // Involuntary context switches
+  struct waitq *wq;            // Wait queue we are sleeping on, if any
+  struct proc *wq_next;        // Next sleeper on that wait queue
+  int rwadmit;                 // Let in by admit_readers(); under rw->lk
+  struct plock_node pnode;     // Our entry while waiting for a plock
+  struct cpu *rqcpu;           // Cpu whose run queue we are on, if any
+  int eprio;                   // Priority inherited from lock waiters
+  int npilocks;                // Plocks and sleep locks held
+  struct proc **waitowner;     // Owner field of the lock we wait for
+  uint *futex;                 // Word we wait on in futexwait()
+  struct vma vma[NVMA];        // Program segments and mmap() regions
+};
+
+// Per-CPU queue of RUNNABLE processes.  E-cores use the
+// linked list (round robin), P-cores use the heap (FCFS).
+struct runq {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+  struct proc *heap[NPROC];    // Heap on (eprio desc, ctime, pid); see older()
+  int len;                     // Number of queued processes
 };
 
 struct cpu {
@@ -48,6 +98,17 @@ struct cpu {
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
   int core_type;
+  struct runq rq;              // Processes waiting to run on this cpu
+  uint nsteal;                 // Processes taken from other cpus' queues
+  uint nswitch;                // Context switches into a process
+  volatile uint idle;          // Halted in idle() waiting for work
+  uint lathist[NSCHEDHIST];    // Log2 histogram of queue-to-run latency
+  uint nexit;                  // Processes that exited here
+  uint nfork;                  // Processes forked here
+  uint nsyscall;               // System calls made here
+  uint busyticks;              // Timer ticks taken while running a process
+  uint idleticks;              // Ticks spent halted in idle()
+  volatile uint rcugen;        // rcu generation at last quiescent state
 };
 
 struct ptable {
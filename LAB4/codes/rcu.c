@@ -0,0 +1,81 @@
+// Read-copy-update style deferred reuse of table slots.
+//
+// Lookups that only read a table (process slots by pid, inode
+// cache entries by dev/inum) can run without locks between
+// rcu_read_lock() and rcu_read_unlock(), which just disable
+// interrupts so the cpu cannot switch processes meanwhile.
+//
+// A cpu passes a quiescent state, and so holds no pointer
+// from an earlier read section, each time scheduler() goes
+// around its loop, while it is halted in idle(), and when the
+// timer interrupts user code.  A writer that unlinks an entry
+// tags it with rcu_retire() and must not reuse it for a
+// different object until rcu_done() says every cpu has passed
+// a quiescent state since.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+
+static volatile uint rcugen;  // Bumped by every rcu_retire()
+
+void
+rcu_read_lock(void)
+{
+  pushcli();
+}
+
+void
+rcu_read_unlock(void)
+{
+  popcli();
+}
+
+// Record that c is outside any read section.  The fence
+// orders the reads of the section just finished, and the
+// store clearing c->idle, before the store writers look at.
+void
+rcu_quiescent(struct cpu *c)
+{
+  __sync_synchronize();
+  c->rcugen = rcugen;
+}
+
+// Start a grace period for an entry just unlinked; returns
+// the generation to pass to rcu_done() or rcu_wait().
+uint
+rcu_retire(void)
+{
+  return __sync_add_and_fetch(&rcugen, 1);
+}
+
+// Has every cpu passed a quiescent state since gen?
+// Halted cpus count as quiescent: they may sleep with the
+// timer off and would otherwise stall the grace period.
+int
+rcu_done(uint gen)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(!c->idle && (int)(c->rcugen - gen) < 0)
+      return 0;
+  return 1;
+}
+
+// Wait for the grace period of gen to end.  The caller must
+// not be in a read section or hold a spinlock.
+void
+rcu_wait(uint gen)
+{
+  while(!rcu_done(gen)){
+    if(myproc())
+      yield();
+    else
+      asm volatile("pause");
+  }
+}
@@ -7,22 +7,90 @@
 #include "proc.h"
 #include "spinlock.h"
 #include "rwlock.h"
+#include "lockdep.h"
 
 void
 rwlock_init(struct rwlock *rw, char *name)
 {
   initlock(&rw->lk, "rw spinlock");
   rw->name = name;
+  rw->class = lockclass(name);
+  rw->policy = RW_READPREF;
   rw->read_count = 0;
   rw->write_locked = 0;
+  rw->writer = 0;
+  rw->readers.head = rw->readers.tail = 0;
+  rw->writers.head = rw->writers.tail = 0;
+}
+
+// Set the policy; returns the old one.
+int
+rwlock_setpolicy(struct rwlock *rw, int policy)
+{
+  int old;
+
+  acquire(&rw->lk);
+  old = rw->policy;
+  rw->policy = policy;
+  release(&rw->lk);
+  return old;
+}
+
+// May a newly arriving reader go in?
+static int
+readerok(struct rwlock *rw)
+{
+  if(rw->write_locked)
+    return 0;
+  if(rw->policy == RW_READPREF)
+    return 1;
+  return rw->writers.head == 0;
+}
+
+// Give the lock to the oldest waiting writer, if any.
+static int
+handoff_writer(struct rwlock *rw)
+{
+  struct proc *p;
+
+  if((p = wakeone(&rw->writers)) == 0)
+    return 0;
+  rw->write_locked = 1;
+  rw->writer = p;
+  return 1;
+}
+
+// Let in every queued reader as one batch.
+static int
+admit_readers(struct rwlock *rw)
+{
+  struct proc *p;
+  int n = 0;
+
+  for(p = rw->readers.head; p; p = p->wq_next){
+    p->rwadmit = 1;
+    n++;
+  }
+  rw->read_count += n;
+  wakeall(&rw->readers);
+  return n;
 }
 
 void
 rwlock_acquire_read(struct rwlock *rw)
 {
+  struct proc *p = myproc();
+
+  lockdep_acquiresleep(rw, rw->class);
   acquire(&rw->lk);
-  while(rw->write_locked) {
-    sleep(rw, &rw->lk);
+  while(!readerok(rw)) {
+    sleepq(&rw->readers, &rw->lk);
+    if(p->rwadmit){
+      // Admitted and counted by admit_readers().
+      p->rwadmit = 0;
+      release(&rw->lk);
+      return;
+    }
   }
   rw->read_count++;
   release(&rw->lk);
@@ -31,10 +99,11 @@ rwlock_acquire_read(struct rwlock *rw)
 void
 rwlock_release_read(struct rwlock *rw)
 {
+  lockdep_releasesleep(rw);
   acquire(&rw->lk);
   rw->read_count--;
   if(rw->read_count == 0) {
-    wakeup(rw);
+    handoff_writer(rw);
   }
   release(&rw->lk);
 }
@@ -42,19 +111,32 @@ rwlock_release_read(struct rwlock *rw)
 void
 rwlock_acquire_write(struct rwlock *rw)
 {
+  struct proc *p = myproc();
+
+  lockdep_acquiresleep(rw, rw->class);
   acquire(&rw->lk);
-  while(rw->write_locked || rw->read_count > 0) {
-    sleep(rw, &rw->lk);
+  // A releasing reader or writer may hand the lock to us.
+  while(rw->writer != p) {
+    if(!rw->write_locked && rw->read_count == 0 && rw->writers.head == 0) {
+      rw->write_locked = 1;
+      rw->writer = p;
+      break;
+    }
+    sleepq(&rw->writers, &rw->lk);
   }
-  rw->write_locked = 1;
   release(&rw->lk);
 }
 
 void
 rwlock_release_write(struct rwlock *rw)
 {
+  lockdep_releasesleep(rw);
   acquire(&rw->lk);
   rw->write_locked = 0;
-  wakeup(rw);
+  rw->writer = 0;
+  if(rw->policy == RW_WRITEPREF && handoff_writer(rw))
+    ;
+  else if(admit_readers(rw) == 0)
+    handoff_writer(rw);
   release(&rw->lk);
-}
\ No newline at end of file
+}
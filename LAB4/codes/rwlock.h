@@ -2,12 +2,27 @@
 #define __RWLOCK_H__
 
 #include "spinlock.h"
+#include "waitq.h"
+
+// Policies.  Reader-preferring lets new readers in while a
+// writer waits; writer-preferring holds new readers back
+// while any writer waits; phase-fair alternates, letting in
+// every reader that queued during a write as one batch.
+// Locks start reader-preferring, the original behaviour.
+#define RW_READPREF   0
+#define RW_WRITEPREF  1
+#define RW_PHASEFAIR  2
 
 struct rwlock {
   struct spinlock lk;
   char *name;
+  int class;              // Lock class of name, for lockdep
+  int policy;             // RW_READPREF, RW_WRITEPREF or RW_PHASEFAIR
   int read_count;
   int write_locked;
+  struct proc *writer;    // Writer holding the lock
+  struct waitq readers;   // Readers waiting for the writer to leave
+  struct waitq writers;   // Writers waiting for the lock to be free
 };
 
-#endif
\ No newline at end of file
+#endif
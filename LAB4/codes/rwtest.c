@@ -27,7 +27,39 @@ void writer(int id) {
     exit();
 }
 
-int main() {
+#define BENCHOPS 100000
+
+// Read ops/sec with k readers running at once, on the
+// rwlock (kind 0) or the per-cpu brlock (kind 1).
+void bench(int kind) {
+    int k, t0, ticks;
+
+    for(k = 1; k <= 8; k *= 2) {
+        t0 = uptime();
+        for(int i = 0; i < k; i++) {
+            if(fork() == 0) {
+                rwbench(kind, BENCHOPS);
+                exit();
+            }
+        }
+        for(int i = 0; i < k; i++)
+            wait();
+        ticks = uptime() - t0;
+        if(ticks == 0)
+            ticks = 1;
+        printf(1, "%s, %d readers: %d reads/sec\n", kind ? "brlock" : "rwlock",
+               k, (k * BENCHOPS / ticks) * 100);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+        test_init_locks();
+        bench(0);
+        bench(1);
+        exit();
+    }
+
     printf(1, "Starting RW-Lock Test...\n");
  
     for(int i=1; i<=3; i++){
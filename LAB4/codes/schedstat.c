@@ -0,0 +1,134 @@
+#include "types.h"
+#include "stat.h"
+#include "param.h"
+#include "schedstat.h"
+#include "user.h"
+
+#define N 6
+#define ROUNDS 20
+#define WORK 200000
+
+struct schedstat before, after;
+
+// Compute for a while, then sleep a tick, so every round puts
+// the child back on a run queue.
+void child(int go, int done) {
+    char c;
+
+    for(int r = 0; r < ROUNDS; r++) {
+        volatile double x = 0;
+        for(int j = 0; j < WORK; j++) {
+            x += 1;
+        }
+        sleep(1);
+    }
+    // Report in and stay alive until the parent has read our stats.
+    write(done, "x", 1);
+    read(go, &c, 1);
+    exit();
+}
+
+void print_procs(struct schedstat *st, int *pids) {
+    printf(1, "\npid\tname\tclass\twait\trun\tvol\tinvol\t(times in kcycles)\n");
+    for(int i = 0; i < NPROC; i++) {
+        struct procstat *p = &st->proc[i];
+        int mine = 0;
+
+        for(int k = 0; pids && k < N; k++) {
+            if(pids[k] == p->pid)
+                mine = 1;
+        }
+        if(p->pid == 0 || (pids && !mine))
+            continue;
+        printf(1, "%d\t%s\t%s\t%d\t%d\t%d\t%d\n", p->pid, p->name,
+               p->core_pref ? "P" : "E", p->wait_time, p->run_time,
+               p->nvcsw, p->nivcsw);
+    }
+}
+
+// Sum the latency histograms of each core class, minus the
+// counts already present in base (if any).
+void print_hist(struct schedstat *st, struct schedstat *base) {
+    uint h[2][NSCHEDHIST], n[2];
+
+    memset(h, 0, sizeof(h));
+    n[0] = n[1] = 0;
+    for(int i = 0; i < st->ncpu; i++) {
+        int t = st->cpu[i].core_type;
+        for(int b = 0; b < NSCHEDHIST; b++) {
+            uint v = st->cpu[i].lathist[b];
+            if(base)
+                v -= base->cpu[i].lathist[b];
+            h[t][b] += v;
+            n[t] += v;
+        }
+    }
+
+    printf(1, "\nRUNNABLE -> RUNNING latency (kcycles)\n");
+    printf(1, "bucket\t\tE-core (RR)\tP-core (FCFS)\n");
+    for(int b = 0; b < NSCHEDHIST; b++) {
+        if(h[0][b] == 0 && h[1][b] == 0)
+            continue;
+        if(b == 0)
+            printf(1, "<2\t\t");
+        else if(b == NSCHEDHIST - 1)
+            printf(1, ">=%d\t\t", 1 << b);
+        else
+            printf(1, "%d-%d\t\t", 1 << b, 1 << (b + 1));
+        printf(1, "%d\t\t%d\n", h[0][b], h[1][b]);
+    }
+    printf(1, "total\t\t%d\t\t%d\n", n[0], n[1]);
+}
+
+int main(int argc, char *argv[]) {
+    int go[2], done[2], pids[N];
+    char c;
+
+    // Without arguments just dump what the kernel has now.
+    if(argc < 2 || strcmp(argv[1], "-w") != 0) {
+        if(getschedstat(&after) < 0) {
+            printf(2, "schedstat: getschedstat failed\n");
+            exit();
+        }
+        print_procs(&after, 0);
+        print_hist(&after, 0);
+        exit();
+    }
+
+    printf(1, "schedstat: %d children, %d rounds of work + sleep\n", N, ROUNDS);
+    if(pipe(go) < 0 || pipe(done) < 0) {
+        printf(2, "schedstat: pipe failed\n");
+        exit();
+    }
+    getschedstat(&before);
+
+    for(int i = 0; i < N; i++) {
+        pids[i] = fork();
+        if(pids[i] < 0) {
+            printf(2, "schedstat: fork failed\n");
+            exit();
+        }
+        if(pids[i] == 0) {
+            close(go[1]);
+            close(done[0]);
+            child(go[0], done[1]);
+        }
+    }
+    close(go[0]);
+    close(done[1]);
+
+    for(int i = 0; i < N; i++) {
+        read(done[0], &c, 1);
+    }
+    getschedstat(&after);
+
+    // Let the children exit.
+    close(go[1]);
+    for(int i = 0; i < N; i++) {
+        wait();
+    }
+
+    print_procs(&after, pids);
+    print_hist(&after, &before);
+    exit();
+}
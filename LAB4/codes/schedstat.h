@@ -0,0 +1,30 @@
+#define NSCHEDHIST 24   // log2 buckets of scheduling latency
+
+// Scheduling statistics returned by getschedstat().
+// Times are in units of 1024 TSC cycles (kcycles).
+
+struct procstat {
+  int pid;
+  int ppid;           // Parent's pid, 0 if none
+  int state;          // enum procstate
+  int core_pref;      // CORE_E or CORE_P
+  char name[16];
+  uint wait_time;     // Time spent RUNNABLE on a run queue
+  uint run_time;      // Time spent RUNNING
+  uint nvcsw;         // Voluntary switches (slept)
+  uint nivcsw;        // Involuntary switches (preempted)
+};
+
+// Bucket 0 counts latencies below 2 kcycles, bucket i
+// counts [2^i, 2^(i+1)) kcycles, the last bucket the rest.
+struct cpustat {
+  int core_type;
+  uint nswitch;
+  uint lathist[NSCHEDHIST];
+};
+
+struct schedstat {
+  int ncpu;
+  struct cpustat cpu[NCPU];
+  struct procstat proc[NPROC];   // pid 0 marks an unused slot
+};
@@ -0,0 +1,45 @@
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+// Sequence lock for data that is read far more often than it
+// is written.  Readers take no lock and write nothing shared:
+// they retry if a write was in progress or happened meanwhile.
+// seq is odd while a write is in progress.  Writers must be
+// serialized by some other lock.
+struct seqlock {
+  volatile uint seq;
+};
+
+static inline uint
+read_seqbegin(struct seqlock *s)
+{
+  uint seq;
+
+  while((seq = s->seq) & 1)
+    asm volatile("pause");
+  __sync_synchronize();
+  return seq;
+}
+
+static inline int
+read_seqretry(struct seqlock *s, uint seq)
+{
+  __sync_synchronize();
+  return s->seq != seq;
+}
+
+static inline void
+write_seqbegin(struct seqlock *s)
+{
+  s->seq++;
+  __sync_synchronize();
+}
+
+static inline void
+write_seqend(struct seqlock *s)
+{
+  __sync_synchronize();
+  s->seq++;
+}
+
+#endif
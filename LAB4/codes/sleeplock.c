@@ -7,39 +7,101 @@
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "lockdep.h"
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
+  lk->class = lockclass(name);
   lk->locked = 0;
+  lk->owner = 0;
   lk->pid = 0;
+  lk->wq.head = lk->wq.tail = 0;
 }
 
+// Is the holder of lk running on some cpu right now?
+// Racy, but only used to decide whether to keep spinning.
+static int
+ownerrunning(struct sleeplock *lk)
+{
+  struct proc *p = lk->owner;
+
+  return p && *(volatile enum procstate*)&p->state == RUNNING;
+}
+
+// Priority a sleeper on a sleep lock lends the holder: its
+// scheduling priority, or what it inherited if that is more.
+static int
+waitprio(struct proc *p)
+{
+  return p->eprio > p->priority ? p->eprio : p->priority;
+}
+
+// Boost holder p on behalf of waiter q, if q outranks it.
+static void
+boost(struct proc *p, struct proc *q)
+{
+  if(waitprio(q) > p->priority)
+    piboost(p, waitprio(q));
+}
+
+// Adaptive mutex: a holder that is running will usually
+// release soon, so spin (without lk->lk) for a bounded time
+// rather than paying for sleep() and wakeup().  Sleep once
+// the holder is descheduled or the budget runs out.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 t0 = rdtsc();
+
+  lockdep_acquiresleep(lk, lk->class);
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  // releasesleep() may hand the lock straight to us.
+  while (lk->locked && lk->owner != myproc()) {
+    if(ownerrunning(lk) && rdtsc() - t0 < SLEEPLOCK_SPIN){
+      release(&lk->lk);
+      while(lk->locked && ownerrunning(lk) && rdtsc() - t0 < SLEEPLOCK_SPIN)
+        asm volatile("pause");
+      acquire(&lk->lk);
+      continue;
+    }
+    myproc()->waitowner = &lk->owner;
+    boost(lk->owner, myproc());
+    sleepq(&lk->wq, &lk->lk);
+    myproc()->waitowner = 0;
   }
   lk->locked = 1;
+  lk->owner = myproc();
   lk->pid = myproc()->pid;
+  myproc()->npilocks++;
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct proc *p, *q;
+
   acquire(&lk->lk);
   if (lk->pid != myproc()->pid) {
       release(&lk->lk);
       panic("releasesleep: not owner");
   }
-  lk->locked = 0;
-  lk->pid = 0;
-  wakeup(lk);
+  lockdep_releasesleep(lk);
+  // Hand the lock to the oldest sleeper, if any.
+  if((p = wakeone(&lk->wq)) != 0){
+    lk->owner = p;
+    lk->pid = p->pid;
+    for(q = lk->wq.head; q; q = q->wq_next)
+      boost(p, q);
+  } else {
+    lk->locked = 0;
+    lk->owner = 0;
+    lk->pid = 0;
+  }
+  pidrop();
   release(&lk->lk);
 }
 
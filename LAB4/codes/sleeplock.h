@@ -2,10 +2,18 @@
 #define __SLEEPLOCK_H__
 
 #include "spinlock.h"  
+#include "waitq.h"
+
+// Waiters spin for up to this many TSC cycles while the holder
+// is running on another cpu before going to sleep.
+#define SLEEPLOCK_SPIN 200000
 
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  volatile uint locked;  // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
+  struct proc *owner; // Process holding lock, for adaptive spinning
+  struct waitq wq;    // Processes sleeping for the lock
+  int class;          // Lock class of name, for lockdep
 
   // For debugging:
   char *name;        // Name of lock.
@@ -8,7 +8,78 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
+#include "lockdep.h"
 
+// Lock statistics are kept per lock class: all locks with
+// the same name share a class.  Each cpu updates only its
+// own cache-line-aligned block of counters, so collecting
+// them does not add cache traffic between cpus.  Class 0
+// collects locks that do not fit in the registry.
+struct lockslot {
+  uint nacquire;
+  uint nspin;
+  uint maxhold;
+  uint maxwait;
+};
+
+static struct {
+  struct lockslot slot[NLOCKCLASS];
+} __attribute__((aligned(64))) lockcpu[NCPU];
+
+#ifndef QLOCK
+#define QLOCK LK_TAS
+#endif
+
+#define NMCSNODE 4   // MCS locks one cpu can hold or wait for at once
+
+static struct mcsnode mcsnodes[NCPU][NMCSNODE];
+
+static char *classname[NLOCKCLASS] = { "other" };
+static int nclass = 1;
+static uint classlock;
+
+// Find the class for a lock name, adding it if needed.
+int
+lockclass(char *name)
+{
+  int i, n;
+
+  n = nclass;
+  for(i = 1; i < n; i++)
+    if(classname[i] == name || strncmp(classname[i], name, 16) == 0)
+      return i;
+
+  // Called before mycpu() works (kinit1), so no pushcli;
+  // no interrupt handler creates locks.
+  while(xchg(&classlock, 1) != 0)
+    ;
+  for(; i < nclass; i++)
+    if(strncmp(classname[i], name, 16) == 0)
+      break;
+  if(i == nclass){
+    if(nclass < NLOCKCLASS){
+      classname[nclass] = name;
+      __sync_synchronize();
+      nclass++;
+    } else {
+      // Untracked by lockdep, and merged in lock statistics.
+      cprintf("lockclass: more than %d lock names, %s goes in class 0\n",
+              NLOCKCLASS - 1, name);
+      i = 0;
+    }
+  }
+  xchg(&classlock, 0);
+  return i;
+}
+
+char*
+lockclassname(int i)
+{
+  if(i < 0 || i >= nclass)
+    return "?";
+  return classname[i];
+}
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -16,11 +87,100 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
-  
-  // --- تغییرات بخش ۲: سوال ۴  ---
-  for(int i=0; i<NCPU; i++) {
-    lk->acq_count[i] = 0;
-    lk->total_spins[i] = 0;
+  lk->class = lockclass(name);
+  lk->type = LK_TAS;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->tail = 0;
+  lk->node = 0;
+}
+
+// Initialize a lock that is contended enough to need a fair
+// queue lock: a ticket or MCS lock, chosen by QLOCK at build
+// time.  Same acquire/release/holding API as any spinlock.
+void
+initqlock(struct spinlock *lk, char *name)
+{
+  initlock(lk, name);
+  lk->type = QLOCK;
+}
+
+// Spin until lk is ours.  Returns the number of spins.
+static uint
+spinacquire(struct spinlock *lk)
+{
+  struct mcsnode *n, *prev;
+  uint spins = 0, t;
+
+  switch(lk->type){
+  case LK_TICKET:
+    t = __sync_fetch_and_add(&lk->next, 1);
+    while(lk->owner != t){
+      asm volatile("pause");
+      spins++;
+    }
+    break;
+  case LK_MCS:
+    for(n = mcsnodes[mycpu() - cpus]; n->busy; n++)
+      if(n == &mcsnodes[mycpu() - cpus][NMCSNODE-1])
+        panic("acquire: out of mcs nodes");
+    n->busy = 1;
+    n->next = 0;
+    n->locked = 1;
+    prev = (struct mcsnode*)xchg((uint*)&lk->tail, (uint)n);
+    if(prev){
+      prev->next = n;
+      while(n->locked){
+        asm volatile("pause");
+        spins++;
+      }
+    }
+    lk->node = n;
+    break;
+  default:
+    // The xchg is atomic.
+    while(xchg(&lk->locked, 1) != 0)
+      spins++;
+    return spins;
+  }
+  lk->locked = 1;
+  return spins;
+}
+
+// Hand lk to the next waiter, if any.
+static void
+spinrelease(struct spinlock *lk)
+{
+  struct mcsnode *n;
+
+  switch(lk->type){
+  case LK_TICKET:
+    lk->locked = 0;
+    __sync_synchronize();
+    lk->owner++;
+    break;
+  case LK_MCS:
+    n = lk->node;
+    lk->node = 0;
+    lk->locked = 0;
+    __sync_synchronize();
+    if(n->next == 0){
+      if(__sync_bool_compare_and_swap(&lk->tail, n, 0)){
+        n->busy = 0;
+        break;
+      }
+      // A waiter is between its xchg and linking in.
+      while(n->next == 0)
+        asm volatile("pause");
+    }
+    n->next->locked = 0;
+    n->busy = 0;
+    break;
+  default:
+    // Release the lock, equivalent to lk->locked = 0.
+    // This code can't use a C assignment, since it might
+    // not be atomic. A real OS would use C atomics here.
+    asm volatile("movl $0, %0" : "+m" (lk->locked) : );
   }
 }
 
@@ -29,18 +189,17 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct lockslot *ls;
+  uint64 t0;
+  uint spins, wait;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
+  lockdep_acquire(lk);
 
- 
-  int loop_count = 0;
-
-  // The xchg is atomic.
-  
-  while(xchg(&lk->locked, 1) != 0) {
-      loop_count++;
-  }
+  t0 = rdtsc();
+  spins = spinacquire(lk);
 
   // Tell the C compiler and the processor to not move loads or stores...
   __sync_synchronize();
@@ -48,21 +207,31 @@ acquire(struct spinlock *lk)
   // Record info about lock acquisition for debugging.
   lk->cpu = mycpu();
   getcallerpcs(&lk, lk->pcs);
- 
-  int id = cpuid(); 
-  
-  lk->acq_count[id]++;       
-  lk->total_spins[id] += loop_count;  
-}
 
- 
+  lk->tacquire = rdtsc();
+  wait = lk->tacquire - t0;
+  ls = &lockcpu[lk->cpu - cpus].slot[lk->class];
+  ls->nacquire++;
+  ls->nspin += spins;
+  if(wait > ls->maxwait)
+    ls->maxwait = wait;
+}
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  struct lockslot *ls;
+  uint hold;
+
   if(!holding(lk))
     panic("release");
+  lockdep_release(lk);
+
+  hold = rdtsc() - lk->tacquire;
+  ls = &lockcpu[lk->cpu - cpus].slot[lk->class];
+  if(hold > ls->maxhold)
+    ls->maxhold = hold;
 
   lk->pcs[0] = 0;
   lk->cpu = 0;
@@ -74,14 +243,46 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  spinrelease(lk);
 
   popcli();
 }
 
+// Sum the statistics of lock class i over all cpus.
+// Returns -1 if there is no such class.
+int
+lockstat(int i, struct lockstat *st)
+{
+  struct lockslot *ls;
+  int c;
+
+  if(i < 0 || i >= nclass)
+    return -1;
+  memset(st, 0, sizeof(*st));
+  safestrcpy(st->name, classname[i], sizeof(st->name));
+  for(c = 0; c < ncpu; c++){
+    ls = &lockcpu[c].slot[i];
+    st->nacquire += ls->nacquire;
+    st->nspin += ls->nspin;
+    if(ls->maxhold > st->maxhold)
+      st->maxhold = ls->maxhold;
+    if(ls->maxwait > st->maxwait)
+      st->maxwait = ls->maxwait;
+  }
+  return 0;
+}
+
+// Average spins per acquisition of lk's class on one cpu.
+int
+lockavgspin(struct spinlock *lk, int c)
+{
+  struct lockslot *ls = &lockcpu[c].slot[lk->class];
+
+  if(ls->nacquire == 0)
+    return 0;
+  return ls->nspin / ls->nacquire;
+}
+
 // Record the current call stack in pcs[] by following the %ebp chain.
 void
 getcallerpcs(void *v, uint pcs[])
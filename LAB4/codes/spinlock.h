@@ -1,6 +1,20 @@
 #ifndef __SPINLOCK_H__
 #define __SPINLOCK_H__
 
+// Lock algorithms.  initlock() locks are test-and-set;
+// initqlock() locks use the build's QLOCK algorithm.
+#define LK_TAS    0
+#define LK_TICKET 1
+#define LK_MCS    2
+
+// MCS queue node.  Each waiter spins on the locked flag of
+// its own node, which sits alone on a cache line.
+struct mcsnode {
+  struct mcsnode *volatile next;
+  volatile uint locked;
+  uint busy;         // In use by this cpu
+} __attribute__((aligned(64)));
+
 struct spinlock {
   uint locked;       // Is the lock held?
 
@@ -10,9 +24,15 @@ struct spinlock {
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
 
+  int type;          // LK_TAS, LK_TICKET or LK_MCS
+  volatile uint next;     // Ticket: next ticket to hand out
+  volatile uint owner;    // Ticket: ticket now being served
+  struct mcsnode *volatile tail;  // MCS: last waiter in the queue
+  struct mcsnode *node;   // MCS: the holder's queue node
 
-  uint acq_count[NCPU];   
-  uint total_spins[NCPU]; 
+  // For lock statistics:
+  int class;         // Index in the lock class registry
+  uint64 tacquire;   // TSC when the holder acquired the lock
 };
 
  
@@ -12,7 +12,9 @@ fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if(!uvmvalid(curproc, addr, 4, 0))
+    return -1;
+  if(uvmpopulate(addr, 4) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -23,12 +25,18 @@ fetchstr(uint addr, char **pp)
 {
   char *s, *ep;
   struct proc *curproc = myproc();
+  struct vma *v;
 
-  if(addr >= curproc->sz)
+  if(addr < curproc->sz)
+    ep = (char*)curproc->sz;
+  else if((v = vmalookup(curproc->vma, addr)) != 0)
+    ep = (char*)v->end;
+  else
     return -1;
   *pp = (char*)addr;
-  ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) && uvmpopulate((uint)s, 1) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -49,12 +57,25 @@ argptr(int n, char **pp, int size)
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0 || !uvmvalid(curproc, i, size, 0))
+    return -1;
+  if(uvmpopulate(i, size) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
 }
 
+// Like argptr, for memory the kernel will write to.
+int
+argptrw(int n, char **pp, int size)
+{
+  if(argptr(n, pp, size) < 0)
+    return -1;
+  if(!uvmvalid(myproc(), (uint)*pp, size, 1))
+    return -1;
+  return 0;
+}
+
 int
 argstr(int n, char **pp)
 {
@@ -108,6 +129,22 @@ extern int sys_rw_reader_enter(void);
 extern int sys_rw_reader_exit(void);
 extern int sys_rw_writer_enter(void);
 extern int sys_rw_writer_exit(void);
+extern int sys_getstealstat(void);
+extern int sys_setsteal(void);
+extern int sys_set_quantum(void);
+extern int sys_cswitches(void);
+extern int sys_getschedstat(void);
+extern int sys_getlockstats(void);
+extern int sys_setpi(void);
+extern int sys_set_rwpolicy(void);
+extern int sys_rwbench(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
+extern int sys_shmalloc(void);
+extern int sys_kallocstat(void);
+extern int sys_setcow(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -153,6 +190,22 @@ static int (*syscalls[])(void) = {
 [SYS_rw_reader_exit]  sys_rw_reader_exit,
 [SYS_rw_writer_enter] sys_rw_writer_enter,
 [SYS_rw_writer_exit]  sys_rw_writer_exit,
+[SYS_getstealstat] sys_getstealstat,
+[SYS_setsteal]     sys_setsteal,
+[SYS_set_quantum]  sys_set_quantum,
+[SYS_cswitches]    sys_cswitches,
+[SYS_getschedstat] sys_getschedstat,
+[SYS_getlockstats] sys_getlockstats,
+[SYS_setpi]        sys_setpi,
+[SYS_set_rwpolicy] sys_set_rwpolicy,
+[SYS_rwbench]      sys_rwbench,
+[SYS_futex_wait]   sys_futex_wait,
+[SYS_futex_wake]   sys_futex_wake,
+[SYS_shmalloc]     sys_shmalloc,
+[SYS_kallocstat]   sys_kallocstat,
+[SYS_setcow]       sys_setcow,
+[SYS_mmap]         sys_mmap,
+[SYS_munmap]       sys_munmap,
 };
 
 void
@@ -162,6 +215,9 @@ syscall(void)
   struct proc *curproc = myproc();
 
   num = curproc->tf->eax;
+  pushcli();
+  mycpu()->nsyscall++;
+  popcli();
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     curproc->tf->eax = syscalls[num]();
   } else {
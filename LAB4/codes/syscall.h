@@ -40,4 +40,20 @@
 #define SYS_rw_reader_enter 40
 #define SYS_rw_reader_exit  41
 #define SYS_rw_writer_enter 42
-#define SYS_rw_writer_exit  43
\ No newline at end of file
+#define SYS_rw_writer_exit  43
+#define SYS_getstealstat 44
+#define SYS_setsteal 45
+#define SYS_set_quantum 46
+#define SYS_cswitches 47
+#define SYS_getschedstat 48
+#define SYS_getlockstats 49
+#define SYS_setpi 50
+#define SYS_set_rwpolicy 51
+#define SYS_rwbench 52
+#define SYS_futex_wait 53
+#define SYS_futex_wake 54
+#define SYS_shmalloc 55
+#define SYS_kallocstat 56
+#define SYS_setcow 57
+#define SYS_mmap 58
+#define SYS_munmap 59
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "memlayout.h"
 #include "proc.h"
 #include "fs.h"
 #include "spinlock.h"
@@ -16,6 +17,7 @@
 #include "string.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
 #include "buf.h"
 #include "x86.h"
 
@@ -76,7 +78,7 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptrw(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -112,7 +114,7 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argptrw(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -425,7 +427,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argptrw(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -528,7 +530,7 @@ sys_grep_syscall(void)
 
     if (argint(3, &buffer_size) < 0 || buffer_size <= 0 ||
         argstr(0, &keyword) < 0 || argstr(1, &filename) < 0 ||
-        argptr(2, &user_buffer, buffer_size) < 0) {
+        argptrw(2, &user_buffer, buffer_size) < 0) {
         return -1;
     }
 
@@ -614,3 +616,105 @@ sys_grep_syscall(void)
     kfree(buf);
     return result;
 }
+
+// Map len bytes of fd from offset off, or zeroed memory with
+// MAP_ANON, at an address of the kernel's choosing (addr is
+// ignored).  Pages are read in on first touch by vmafault().
+int
+sys_mmap(void)
+{
+  int addr, len, prot, flags, off;
+  struct file *f = 0;
+  struct proc *curproc = myproc();
+  struct vma *v, *w;
+  uint start, end;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(5, &off) < 0)
+    return -1;
+  if(len <= 0 || off < 0 || off % PGSIZE != 0)
+    return -1;
+  if((flags & (MAP_SHARED|MAP_PRIVATE)) == 0 ||
+     (flags & (MAP_SHARED|MAP_PRIVATE)) == (MAP_SHARED|MAP_PRIVATE))
+    return -1;
+  if((flags & MAP_ANON) == 0){
+    if(argfd(4, 0, &f) < 0 || f->type != FD_INODE || !f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+  }
+  for(v = curproc->vma; v < &curproc->vma[NVMA]; v++)
+    if(v->flags == 0)
+      break;
+  if(v == &curproc->vma[NVMA])
+    return -1;
+
+  // First fit, from the top of user memory down.
+  len = PGROUNDUP(len);
+  end = KERNBASE;
+  for(;;){
+    if(end < (uint)len || end - len < PGROUNDUP(curproc->sz))
+      return -1;
+    start = end - len;
+    for(w = curproc->vma; w < &curproc->vma[NVMA]; w++)
+      if(w->flags && w->start < end && w->end > start)
+        break;
+    if(w == &curproc->vma[NVMA])
+      break;
+    end = w->start;
+  }
+
+  v->start = start;
+  v->end = start + len;
+  v->prot = prot;
+  v->off = off;
+  v->filesz = 0;
+  if(f){
+    ilock(f->ip);
+    if(off < f->ip->size)
+      v->filesz = f->ip->size - off;
+    iunlock(f->ip);
+    if(v->filesz > len)
+      v->filesz = len;
+    v->ip = idup(f->ip);
+  }
+  v->flags = flags;
+  return start;
+}
+
+// Remove the mmap() regions in [addr, addr+len), writing
+// MAP_SHARED file regions back.  Regions must be unmapped
+// whole.
+int
+sys_munmap(void)
+{
+  int addr, len;
+  struct proc *curproc = myproc();
+  struct vma *v;
+  uint start, end, vstart, vend;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  if(len <= 0 || addr % PGSIZE != 0)
+    return -1;
+  start = addr;
+  end = start + PGROUNDUP(len);
+  if(end < start)
+    return -1;
+  for(v = curproc->vma; v < &curproc->vma[NVMA]; v++){
+    if(v->flags == 0 || v->start < curproc->sz || v->start >= end || v->end <= start)
+      continue;
+    if(v->start < start || v->end > end)
+      return -1;
+  }
+  for(v = curproc->vma; v < &curproc->vma[NVMA]; v++){
+    if(v->flags == 0 || v->start < curproc->sz || v->start >= end || v->end <= start)
+      continue;
+    vstart = v->start;
+    vend = v->end;
+    vmaput(curproc->pgdir, v);
+    deallocuvm(curproc->pgdir, vend, vstart);
+  }
+  switchuvm(curproc);
+  return 0;
+}
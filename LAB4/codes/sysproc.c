@@ -9,25 +9,36 @@
 #include "spinlock.h" 
 #include "sleeplock.h"
 #include "rwlock.h"
+#include "brlock.h"
+#include "waitq.h"
 #include "plock.h"
+#include "perfstat.h"
+#include "lockstat.h"
+#include "kallocstat.h"
 
 extern struct ptable ptable;
 extern struct spinlock tickslock;
 extern uint ticks;
+extern struct waitq tickswait;
 extern struct plock global_plock;
 extern struct rwlock global_rwlock;
 extern int start_measure(void);
-extern int end_measure(void);
+extern int end_measure(struct perfstat*);
 extern int print_info(void);
+extern int steal_enabled;
+extern int pi_enabled;
+extern int cow_enabled;
 
 struct sleeplock test_sl;
 struct rwlock test_rw;
+struct brlock test_br;
 
 int
 sys_test_init_locks(void)
 {
   initsleeplock(&test_sl, "test_sleep");
   rwlock_init(&test_rw, "test_rw");
+  brlock_init(&test_br, "test_br");
   return 0;
 }
 
@@ -66,6 +77,42 @@ sys_test_rw_write_lock(void)
   return 0;
 }
 
+// Take and drop the test rwlock (kind 0) or brlock (kind 1)
+// for reading n times, for measuring reader scalability.
+int
+sys_rwbench(void)
+{
+  int kind, n, i;
+
+  if(argint(0, &kind) < 0 || argint(1, &n) < 0)
+    return -1;
+  for(i = 0; i < n; i++){
+    if(kind == 0){
+      rwlock_acquire_read(&test_rw);
+      rwlock_release_read(&test_rw);
+    } else {
+      brlock_read_lock(&test_br);
+      brlock_read_unlock(&test_br);
+    }
+  }
+  return 0;
+}
+
+// Set the policy of the test and global rwlocks; returns
+// the old policy.
+int
+sys_set_rwpolicy(void)
+{
+  int policy;
+
+  if(argint(0, &policy) < 0)
+    return -1;
+  if(policy != RW_READPREF && policy != RW_WRITEPREF && policy != RW_PHASEFAIR)
+    return -1;
+  rwlock_setpolicy(&global_rwlock, policy);
+  return rwlock_setpolicy(&test_rw, policy);
+}
+
 int
 sys_test_rw_write_unlock(void)
 {
@@ -122,6 +169,49 @@ sys_sbrk(void)
   return addr;
 }
 
+// Like sbrk, but the new pages stay shared with children
+// forked afterwards, e.g. for user-level locks.  Returns the
+// page-aligned start of the new memory.
+int
+sys_shmalloc(void)
+{
+  struct proc *curproc = myproc();
+  uint addr, sz;
+  int n;
+
+  if(argint(0, &n) < 0 || n <= 0)
+    return -1;
+  addr = PGROUNDUP(curproc->sz);
+  // Stop short of the mmap() regions.
+  if(addr + n < addr || vmaoverlap(curproc->vma, curproc->sz, addr + n))
+    return -1;
+  if((sz = allocshm(curproc->pgdir, addr, addr + n)) == 0)
+    return -1;
+  curproc->sz = sz;
+  switchuvm(curproc);
+  return addr;
+}
+
+int
+sys_futex_wait(void)
+{
+  int addr, val;
+
+  if(argint(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait(addr, val);
+}
+
+int
+sys_futex_wake(void)
+{
+  int addr, n;
+
+  if(argint(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake(addr, n);
+}
+
 int
 sys_sleep(void)
 {
@@ -130,14 +220,16 @@ sys_sleep(void)
 
   if(argint(0, &n) < 0)
     return -1;
+  ticks0 = readticks();
+  if(n <= 0)
+    return 0;
   acquire(&tickslock);
-  ticks0 = ticks;
   while(ticks - ticks0 < n){
     if(myproc()->killed){
       release(&tickslock);
       return -1;
     }
-    sleep(&ticks, &tickslock);
+    sleepq(&tickswait, &tickslock);
   }
   release(&tickslock);
   return 0;
@@ -146,12 +238,7 @@ sys_sleep(void)
 int
 sys_uptime(void)
 {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  return readticks();
 }
 
 int
@@ -173,60 +260,57 @@ sys_simple_arithmetic_syscall(void)
 int
 sys_show_process_family(void) 
 {
-  struct proc *p = 0;  
-  struct proc *parent;
+  struct procstat me, ps;
+  struct proc *np;
   int found_child = 0;
   int found_sibling = 0;
   int pid;  
 
   if(argint(0, &pid) < 0)
     return -1;
-  acquire(&ptable.lock);
-  for(struct proc *np = ptable.proc; np < &ptable.proc[NPROC]; np++){
-    if(np->pid == pid){
-      p = np;
+
+  // Read-only walk: per-process snapshots instead of
+  // holding ptable.lock across all the cprintf()s.
+  me.pid = 0;
+  for(np = ptable.proc; np < &ptable.proc[NPROC]; np++)
+    if(procsnap(np, &me) == pid)
       break;
-    }
-  }
 
-  if(p == 0){
-    release(&ptable.lock);
+  if(me.pid != pid || pid == 0){
     cprintf("Process with PID %d not found.\n", pid);
     return -1;
   }
 
-  parent = p->parent;
-  if(parent){
-    cprintf("My id: %d, My parent id: %d\n", p->pid, parent->pid);
+  if(me.ppid){
+    cprintf("My id: %d, My parent id: %d\n", me.pid, me.ppid);
   } else {
-    cprintf("My id: %d, I have no parent.\n", p->pid);
+    cprintf("My id: %d, I have no parent.\n", me.pid);
   }
 
-  cprintf("Children of process %d:\n", p->pid);
-  for(struct proc *np = ptable.proc; np < &ptable.proc[NPROC]; np++){
-    if(np->parent == p){ 
-      cprintf("Child pid: %d\n", np->pid);
+  cprintf("Children of process %d:\n", me.pid);
+  for(np = ptable.proc; np < &ptable.proc[NPROC]; np++){
+    if(procsnap(np, &ps) && ps.ppid == me.pid){ 
+      cprintf("Child pid: %d\n", ps.pid);
       found_child = 1;
     }
   }
   if(!found_child)
     cprintf("No children found.\n");
 
-  cprintf("Siblings of process %d:\n", p->pid);
-  if(!parent){
+  cprintf("Siblings of process %d:\n", me.pid);
+  if(!me.ppid){
     cprintf("No siblings (process has no parent).\n");
   } else {
-    for(struct proc *np = ptable.proc; np < &ptable.proc[NPROC]; np++){
-      if(np->parent == parent && np != p){  
-        cprintf("Sibling pid: %d\n", np->pid);
+    for(np = ptable.proc; np < &ptable.proc[NPROC]; np++){
+      if(procsnap(np, &ps) && ps.ppid == me.ppid && ps.pid != me.pid){  
+        cprintf("Sibling pid: %d\n", ps.pid);
         found_sibling = 1;
       }
     }   
   }
-  if(parent && !found_sibling)
+  if(me.ppid && !found_sibling)
     cprintf("No siblings found.\n");
 
-  release(&ptable.lock);  
   return 0;  
 }
 
@@ -242,16 +326,19 @@ sys_set_priority_syscall(void)
   if (priority < 0 || priority > 2)
     return -1;
 
-  acquire(&ptable.lock);
+  // Lockless: the slot is not reused until we leave the read
+  // section, so at worst this sets the priority of a process
+  // that has just exited.
+  rcu_read_lock();
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
     if(p->pid == pid){
       p->priority = priority;  
-      release(&ptable.lock);
+      rcu_read_unlock();
       return 0;  
     }
   }
 
-  release(&ptable.lock);
+  rcu_read_unlock();
   return -1;
 }
 
@@ -264,7 +351,16 @@ sys_start_measure(void)
 int
 sys_end_measure(void)
 {
-  return end_measure();
+  struct perfstat *ups;
+  struct perfstat ps;
+
+  if(argptrw(0, (void*)&ups, sizeof(*ups)) < 0)
+    return -1;
+  if(end_measure(&ps) < 0)
+    return -1;
+  if(copyout(myproc()->pgdir, (uint)ups, (void*)&ps, sizeof(ps)) < 0)
+    return -1;
+  return 0;
 }
 
 int
@@ -278,22 +374,13 @@ sys_getlockstat(void)
 {
   uint *user_scores; 
    
-  if(argptr(0, (void*)&user_scores, sizeof(uint)*NCPU) < 0)
+  if(argptrw(0, (void*)&user_scores, sizeof(uint)*NCPU) < 0)
     return -1;
 
   uint kscores[NCPU];  
 
-  for(int i = 0; i < NCPU; i++){
- 
-    
-    uint total = ptable.lock.total_spins[i];
-    uint acq = ptable.lock.acq_count[i];
-    
-    if (acq == 0)
-       kscores[i] = 0;
-    else
-       kscores[i] = total / acq;  
-  }
+  for(int i = 0; i < NCPU; i++)
+    kscores[i] = (i < ncpu) ? lockavgspin(&ptable.lock, i) : 0;
  
   if(copyout(myproc()->pgdir, (uint)user_scores, (void*)kscores, sizeof(uint)*NCPU) < 0)
     return -1;
@@ -301,6 +388,25 @@ sys_getlockstat(void)
   return 0;
 }
 
+// Copy statistics for up to n lock classes to a user array
+// of struct lockstat.  Returns the number of classes copied.
+int
+sys_getlockstats(void)
+{
+  struct lockstat *ust;
+  struct lockstat st;
+  int n, i;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(argptrw(0, (void*)&ust, n*sizeof(st)) < 0)
+    return -1;
+  for(i = 0; i < n && lockstat(i, &st) == 0; i++)
+    if(copyout(myproc()->pgdir, (uint)&ust[i], (void*)&st, sizeof(st)) < 0)
+      return -1;
+  return i;
+}
+
 int
 sys_plock_acquire(void)
 {
@@ -342,4 +448,138 @@ int sys_rw_writer_enter(void) {
 int sys_rw_writer_exit(void) {
   rwlock_release_write(&global_rwlock);
   return 0;
-}
\ No newline at end of file
+}
+
+int
+sys_getstealstat(void)
+{
+  uint *user_counts;
+  uint kcounts[NCPU];
+
+  if(argptrw(0, (void*)&user_counts, sizeof(uint)*NCPU) < 0)
+    return -1;
+
+  for(int i = 0; i < NCPU; i++)
+    kcounts[i] = (i < ncpu) ? cpus[i].nsteal : 0;
+
+  if(copyout(myproc()->pgdir, (uint)user_counts, (void*)kcounts, sizeof(uint)*NCPU) < 0)
+    return -1;
+
+  return 0;
+}
+
+// Turn work stealing on or off; returns the previous setting.
+int
+sys_setsteal(void)
+{
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = steal_enabled;
+  steal_enabled = (on != 0);
+  return old;
+}
+
+// Set the time slice of a core class (0 = E, 1 = P) in ticks;
+// 0 turns preemption off for that class.  Returns the old value.
+int
+sys_set_quantum(void)
+{
+  int type, n, old;
+
+  if(argint(0, &type) < 0 || argint(1, &n) < 0)
+    return -1;
+  if((type != CORE_E && type != CORE_P) || n < 0)
+    return -1;
+  old = quantum[type];
+  quantum[type] = n;
+  return old;
+}
+
+// Copy the per-cpu latency histograms and per-process
+// scheduling statistics out to a user struct schedstat.
+int
+sys_getschedstat(void)
+{
+  struct schedstat *st;
+  struct cpustat cs;
+  struct procstat ps;
+  int i;
+
+  if(argptrw(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  if(copyout(myproc()->pgdir, (uint)&st->ncpu, (void*)&ncpu, sizeof(ncpu)) < 0)
+    return -1;
+
+  for(i = 0; i < NCPU; i++){
+    memset(&cs, 0, sizeof(cs));
+    if(i < ncpu){
+      cs.core_type = cpus[i].core_type;
+      cs.nswitch = cpus[i].nswitch;
+      memmove(cs.lathist, cpus[i].lathist, sizeof(cs.lathist));
+    }
+    if(copyout(myproc()->pgdir, (uint)&st->cpu[i], (void*)&cs, sizeof(cs)) < 0)
+      return -1;
+  }
+
+  for(i = 0; i < NPROC; i++){
+    procsnap(&ptable.proc[i], &ps);
+    if(copyout(myproc()->pgdir, (uint)&st->proc[i], (void*)&ps, sizeof(ps)) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Turn priority inheritance on or off; returns the previous
+// setting.
+int
+sys_setpi(void)
+{
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = pi_enabled;
+  pi_enabled = (on != 0);
+  return old;
+}
+
+// Turn copy-on-write fork on or off; returns the previous
+// setting.
+int
+sys_setcow(void)
+{
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = cow_enabled;
+  cow_enabled = (on != 0);
+  return old;
+}
+
+// Total context switches into processes on all cpus.
+int
+sys_cswitches(void)
+{
+  uint n = 0;
+
+  for(int i = 0; i < ncpu; i++)
+    n += cpus[i].nswitch;
+  return n;
+}
+// Copy the per-cpu kalloc magazine counters (NCPU entries)
+// to user space; returns the number of cpus.
+int
+sys_kallocstat(void)
+{
+  struct kallocstat *ust, st[NCPU];
+
+  if(argptrw(0, (void*)&ust, sizeof(st)) < 0)
+    return -1;
+  kallocstat(st);
+  if(copyout(myproc()->pgdir, (uint)ust, (void*)st, sizeof(st)) < 0)
+    return -1;
+  return ncpu;
+}
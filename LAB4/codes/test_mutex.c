@@ -0,0 +1,45 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define N 4
+#define ROUNDS 2000
+
+// N processes take and drop the test sleep lock with a tiny
+// critical section.  With adaptive spinning most handoffs
+// happen without a trip through the scheduler, which shows
+// up as few context switches per acquisition.
+int main(int argc, char *argv[]) {
+    int start, elapsed, csw;
+
+    test_init_locks();
+    csw = cswitches();
+    start = uptime();
+
+    for(int i = 0; i < N; i++) {
+        int pid = fork();
+        if(pid < 0) {
+            printf(1, "Fork failed\n");
+            exit();
+        }
+        if(pid == 0) {
+            for(int j = 0; j < ROUNDS; j++) {
+                test_sl_lock();
+                volatile int x = 0;
+                for(int k = 0; k < 1000; k++)
+                    x++;
+                test_sl_unlock();
+            }
+            exit();
+        }
+    }
+    for(int i = 0; i < N; i++) {
+        wait();
+    }
+
+    elapsed = uptime() - start;
+    csw = cswitches() - csw;
+    printf(1, "%d acquisitions in %d ticks, %d context switches (%d per 100 acquisitions)\n",
+           N * ROUNDS, elapsed, csw, (csw * 100) / (N * ROUNDS));
+    exit();
+}
@@ -0,0 +1,74 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define N 8
+#define WORK 3000000
+
+struct config {
+    char *name;
+    int e_quantum;
+    int p_quantum;
+};
+
+struct config configs[] = {
+    { "E=3  P=1  (old)",  3, 1 },
+    { "E=1  P=1",         1, 1 },
+    { "E=3  P=FCFS",      3, 0 },
+    { "E=10 P=FCFS",     10, 0 },
+};
+
+void run(struct config *c) {
+    int start, elapsed, csw;
+
+    set_quantum(0, c->e_quantum);
+    set_quantum(1, c->p_quantum);
+
+    csw = cswitches();
+    start = uptime();
+
+    for(int i = 0; i < N; i++) {
+        int pid = fork();
+        if(pid < 0) {
+            printf(1, "Fork failed\n");
+            exit();
+        }
+        if(pid == 0) {
+            volatile double x = 0;
+            for(int j = 0; j < WORK; j++) {
+                x += 1;
+            }
+            exit();
+        }
+    }
+    for(int i = 0; i < N; i++) {
+        wait();
+    }
+
+    elapsed = uptime() - start;
+    csw = cswitches() - csw;
+    if(elapsed == 0)
+        elapsed = 1;
+
+    printf(1, "%s: %d ticks, %d context switches, throughput %d procs per 1000 ticks\n",
+           c->name, elapsed, csw, (N * 1000) / elapsed);
+}
+
+int main(int argc, char *argv[]) {
+    int old_e, old_p;
+
+    printf(1, "\n=== Quantum Benchmark: %d CPU-bound processes ===\n", N);
+
+    old_e = set_quantum(0, 3);
+    old_p = set_quantum(1, 0);
+
+    for(int i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        run(&configs[i]);
+    }
+
+    set_quantum(0, old_e);
+    set_quantum(1, old_p);
+
+    printf(1, "=== Benchmark Complete ===\n");
+    exit();
+}
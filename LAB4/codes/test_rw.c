@@ -19,11 +19,66 @@ void writer(int id) {
   test_rw_write_unlock();
 }
 
+#define NREADER 4
+#define STREAM 200   // ticks of back-to-back readers
+
+// Readers that keep the lock busy: at any moment at least one
+// of them is inside.  Each reports how many reads it did.
+void
+stream_reader(int end, int out)
+{
+  int n = 0;
+
+  while(uptime() < end){
+    test_rw_read_lock();
+    sleep(2);
+    test_rw_read_unlock();
+    n++;
+  }
+  write(out, &n, sizeof(n));
+  exit();
+}
+
+// Measure how long a writer waits against a steady stream of
+// readers under one policy.
+void
+stream(int policy, char *name)
+{
+  int fds[2], end, t0, waited, n, reads = 0;
+
+  set_rwpolicy(policy);
+  pipe(fds);
+  end = uptime() + STREAM;
+  for(int i = 0; i < NREADER; i++){
+    if(fork() == 0)
+      stream_reader(end, fds[1]);
+    sleep(1);
+  }
+
+  sleep(10);
+  t0 = uptime();
+  test_rw_write_lock();
+  waited = uptime() - t0;
+  test_rw_write_unlock();
+
+  for(int i = 0; i < NREADER; i++){
+    read(fds[0], &n, sizeof(n));
+    reads += n;
+    wait();
+  }
+  close(fds[0]);
+  close(fds[1]);
+  printf(1, "%s: writer waited %d ticks, %d reads in %d ticks\n",
+         name, waited, reads, STREAM);
+}
+
 int main(void)
 {
   test_init_locks();
 
-  int i;
+  int i, old;
+  // The first part shows the default, reader-preferring lock.
+  old = set_rwpolicy(0);
   for(i = 0; i < 3; i++) {
     if(fork() == 0) {
       reader(i);
@@ -44,5 +99,11 @@ int main(void)
   }
   
   for(i = 0; i < 7; i++) wait();
+
+  printf(1, "\nWriter against %d streaming readers:\n", NREADER);
+  stream(0, "reader-pref");
+  stream(1, "writer-pref");
+  stream(2, "phase-fair ");
+  set_rwpolicy(old);
   exit();
 }
\ No newline at end of file
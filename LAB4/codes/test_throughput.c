@@ -1,43 +1,113 @@
 #include "types.h"
 #include "stat.h"
+#include "param.h"
+#include "perfstat.h"
+#include "schedstat.h"
 #include "user.h"
 
-int main(int argc, char *argv[]) {
-    int N = 10; 
-    
-    printf(1, "\n=== Throughput Test Started ===\n");
-    
- 
+#define N 10
+#define WORK 2000000
+
+static struct schedstat st;
+
+// Context switches so far on each cpu; returns the number
+// of cpus.
+int cpuswitches(uint *nswitch) {
+    if(getschedstat(&st) < 0) {
+        printf(1, "getschedstat failed\n");
+        exit();
+    }
+    for(int i = 0; i < st.ncpu; i++)
+        nswitch[i] = st.cpu[i].nswitch;
+    return st.ncpu;
+}
+
+// Run N CPU-bound children with work stealing on or off.
+// With stealing on, every cpu should get some of them.
+// Returns the elapsed time in ticks.
+int run_round(int steal) {
+    uint before[NCPU], after[NCPU], sw0[NCPU], sw1[NCPU];
+    struct perfstat ps;
+    int elapsed, busy, total = 0, ncpu, nran = 0;
+
+    setsteal(steal);
+    getstealstat(before);
+    cpuswitches(sw0);
+
     start_measure();
 
- 
+
     for(int i = 0; i < N; i++) {
         int pid = fork();
-        
+
         if(pid < 0) {
             printf(1, "Fork failed\n");
             exit();
         }
-        
+
         if(pid == 0) {
-  
+
             volatile double x = 0;
-            for(int j = 0; j < 100000; j++) {
+            for(int j = 0; j < WORK; j++) {
                 x += 1;
             }
-            exit(); 
+            exit();
         }
     }
 
- 
+
     for(int i = 0; i < N; i++) {
         wait();
     }
-    
- 
-    printf(1, "All %d processes finished.\n", N);
-    end_measure();
-    
+    ncpu = cpuswitches(sw1);
+
+
+    if(end_measure(&ps) < 0) {
+        printf(1, "end_measure failed\n");
+        exit();
+    }
+    elapsed = ps.ticks;
+    if(elapsed == 0)
+        elapsed = 1;
+    busy = ps.busyticks + ps.idleticks;
+    if(busy == 0)
+        busy = 1;
+    busy = (ps.busyticks * 100) / busy;
+
+    getstealstat(after);
+    for(int i = 0; i < ncpu; i++) {
+        if(after[i] != before[i])
+            printf(1, "CPU %d stole %d processes\n", i, after[i] - before[i]);
+        total += after[i] - before[i];
+        if(sw1[i] != sw0[i])
+            nran++;
+    }
+    printf(1, "ticks %d finished %d forks %d switches %d syscalls %d busy %d%%\n",
+           ps.ticks, ps.nexit, ps.nfork, ps.nswitch, ps.nsyscall, busy);
+    printf(1, "Steals: %d, elapsed: %d ticks, throughput: %d procs per 1000 ticks\n",
+           total, elapsed, (ps.nexit * 1000) / elapsed);
+    printf(1, "CPUs that ran processes: %d of %d", nran, ncpu);
+    if(steal)
+        printf(1, " (%s)", nran == ncpu ? "ok" : "FAILED, some cpu stayed idle");
+    printf(1, "\n");
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    int old, t_off, t_on;
+
+    printf(1, "\n=== Throughput Test Started ===\n");
+    old = setsteal(1);
+
+    printf(1, "\n--- Work stealing OFF ---\n");
+    t_off = run_round(0);
+
+    printf(1, "\n--- Work stealing ON ---\n");
+    t_on = run_round(1);
+
+    setsteal(old);
+    printf(1, "\nTime with stealing: %d%% of the time without\n", (t_on * 100) / t_off);
+
     printf(1, "=== Test Complete ===\n");
     exit();
-}
\ No newline at end of file
+}
@@ -7,12 +7,16 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "waitq.h"
+#include "seqlock.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+struct waitq tickswait;  // sys_sleep() callers, under tickslock
+struct seqlock tickseq;  // Lets readticks() skip tickslock
 
 void
 tvinit(void)
@@ -50,10 +54,16 @@ trap(struct trapframe *tf)
   case T_IRQ0 + IRQ_TIMER:
     if(cpuid() == 0){
       acquire(&tickslock);
+      write_seqbegin(&tickseq);
       ticks++;
-      wakeup(&ticks);
+      write_seqend(&tickseq);
+      wakeall(&tickswait);
       release(&tickslock);
     }
+    if(myproc())
+      mycpu()->busyticks++;
+    if((tf->cs&3) == DPL_USER)
+      rcu_quiescent(mycpu());
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -71,6 +81,11 @@ trap(struct trapframe *tf)
     uartintr();
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_WAKE:
+    // Another cpu made work for us while we were halted;
+    // the scheduler loop picks it up when we return.
+    lapiceoi();
+    break;
   case T_IRQ0 + 7:
   case T_IRQ0 + IRQ_SPURIOUS:
     cprintf("cpu%d: spurious interrupt at %x:%x\n",
@@ -78,6 +93,13 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // Write to a copy-on-write page, or first touch of a heap
+    // or program page, from user code or from the kernel using
+    // a user pointer (see uvmpopulate).
+    if(myproc() && uvmfault(myproc(), rcr2(), tf->err & 2) == 0)
+      break;
+    // fall through
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -110,15 +132,12 @@ trap(struct trapframe *tf)
     //         cpuid(), mycpu()->core_type, myproc()->pid, myproc()->tick_count);
     // }
 
- 
-    if(mycpu()->core_type == 0) { 
- 
-        if(myproc()->tick_count >= 3) {
-            yield();
-        }
-    } else {
- 
- 
+    // Each core class has its own time slice; a slice of 0
+    // means no preemption (FCFS runs until block or exit).
+    // A lock holder boosted by priority inheritance preempts
+    // either way.
+    int q = quantum[mycpu()->core_type];
+    if((q > 0 && myproc()->tick_count >= q) || needresched()) {
         yield();
     }
   }
@@ -126,4 +145,16 @@ trap(struct trapframe *tf)
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
-}
\ No newline at end of file
+}
+// Read ticks without taking tickslock.
+uint
+readticks(void)
+{
+  uint seq, t;
+
+  do {
+    seq = read_seqbegin(&tickseq);
+    t = ticks;
+  } while(read_seqretry(&tickseq, seq));
+  return t;
+}
@@ -0,0 +1,116 @@
+#include "types.h"
+#include "user.h"
+#include "ulock.h"
+
+void
+umutex_lock(struct umutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->val, 0, 1)) == 0)
+    return;
+  // Contended: mark the lock 2 so the holder's unlock knows
+  // to wake someone, and sleep until it is ours.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->val, 2);
+  while(c != 0){
+    futex_wait(&m->val, 2);
+    c = __sync_lock_test_and_set(&m->val, 2);
+  }
+}
+
+int
+umutex_trylock(struct umutex *m)
+{
+  return __sync_bool_compare_and_swap(&m->val, 0, 1);
+}
+
+void
+umutex_unlock(struct umutex *m)
+{
+  if(__sync_fetch_and_sub(&m->val, 1) != 1){
+    m->val = 0;
+    futex_wake(&m->val, 1);
+  }
+}
+
+// Wait while the state is s.  nwait tells unlockers whether
+// a futex_wake() is needed; if they miss our increment they
+// have already changed state, and futex_wait() returns at once.
+static void
+rwwait(struct urwlock *rw, int s)
+{
+  __sync_fetch_and_add(&rw->nwait, 1);
+  futex_wait(&rw->state, s);
+  __sync_fetch_and_sub(&rw->nwait, 1);
+}
+
+void
+urw_rlock(struct urwlock *rw)
+{
+  int s;
+
+  for(;;){
+    s = rw->state;
+    if(s >= 0){
+      if(__sync_bool_compare_and_swap(&rw->state, s, s+1))
+        return;
+    } else
+      rwwait(rw, s);
+  }
+}
+
+void
+urw_runlock(struct urwlock *rw)
+{
+  if(__sync_sub_and_fetch(&rw->state, 1) == 0 && rw->nwait)
+    futex_wake(&rw->state, 1 << 30);
+}
+
+void
+urw_wlock(struct urwlock *rw)
+{
+  int s;
+
+  while(!__sync_bool_compare_and_swap(&rw->state, 0, -1)){
+    if((s = rw->state) != 0)
+      rwwait(rw, s);
+  }
+}
+
+void
+urw_wunlock(struct urwlock *rw)
+{
+  __sync_lock_test_and_set(&rw->state, 0);
+  if(rw->nwait)
+    futex_wake(&rw->state, 1 << 30);
+}
+
+// Release m and wait for a signal, then take m again.
+// Like any condition variable, callers must recheck their
+// condition in a loop.
+void
+ucond_wait(struct ucond *cv, struct umutex *m)
+{
+  int seq = cv->seq;
+
+  umutex_unlock(m);
+  futex_wait(&cv->seq, seq);
+  // Others may be waiting for m too, so take it as contended.
+  while(__sync_lock_test_and_set(&m->val, 2) != 0)
+    futex_wait(&m->val, 2);
+}
+
+void
+ucond_signal(struct ucond *cv)
+{
+  __sync_fetch_and_add(&cv->seq, 1);
+  futex_wake(&cv->seq, 1);
+}
+
+void
+ucond_broadcast(struct ucond *cv)
+{
+  __sync_fetch_and_add(&cv->seq, 1);
+  futex_wake(&cv->seq, 1 << 30);
+}
@@ -0,0 +1,33 @@
+// User-level locks for processes that share memory from
+// shmalloc() or a MAP_SHARED mmap().  The uncontended paths are a single atomic
+// instruction; only waiting and waking enter the kernel,
+// through futex_wait() and futex_wake().  Zero-filled memory
+// is an unlocked lock, an empty condition and a free rwlock.
+
+// 0 unlocked, 1 locked, 2 locked with possible waiters.
+struct umutex {
+  volatile int val;
+};
+
+// Reader-preferring: > 0 readers, -1 writer, 0 free.
+struct urwlock {
+  volatile int state;
+  volatile int nwait;     // Processes in futex_wait() on state
+};
+
+struct ucond {
+  volatile int seq;       // Bumped by every signal
+};
+
+void umutex_lock(struct umutex*);
+int umutex_trylock(struct umutex*);
+void umutex_unlock(struct umutex*);
+
+void urw_rlock(struct urwlock*);
+void urw_runlock(struct urwlock*);
+void urw_wlock(struct urwlock*);
+void urw_wunlock(struct urwlock*);
+
+void ucond_wait(struct ucond*, struct umutex*);
+void ucond_signal(struct ucond*);
+void ucond_broadcast(struct ucond*);
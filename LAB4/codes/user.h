@@ -1,5 +1,9 @@
 struct stat;
 struct rtcdate;
+struct schedstat;
+struct perfstat;
+struct lockstat;
+struct kallocstat;
 
 int fork(void);
 int exit(void) __attribute__((noreturn));
@@ -28,7 +32,7 @@ int show_process_family(int);
 int grep_syscall(const char*, const char*, char*, int);
 int set_priority_syscall(int, int);
 int start_measure(void);
-int end_measure(void);
+int end_measure(struct perfstat*);
 int print_info(void);
 int test_init_locks(void);
 int test_sl_lock(void);
@@ -47,6 +51,23 @@ int rw_reader_exit(void);
 int rw_writer_enter(void);
 int rw_writer_exit(void);
 
+int getstealstat(uint*);
+int setsteal(int);
+int set_quantum(int, int);
+int cswitches(void);
+int getschedstat(struct schedstat*);
+int getlockstats(struct lockstat*, int);
+int setpi(int);
+int set_rwpolicy(int);
+int rwbench(int, int);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+void* shmalloc(int);
+int kallocstat(struct kallocstat*);
+int setcow(int);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
@@ -6,9 +6,11 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "mman.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
+int cow_enabled = 1;  // fork() shares pages copy-on-write
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -216,10 +218,10 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
   return 0;
 }
 
-// Allocate page tables and physical memory to grow process from oldsz to
-// newsz, which need not be page aligned.  Returns new size or 0 on error.
-int
-allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
+// Grow a process from oldsz to newsz with zeroed pages
+// mapped with perm.  Returns new size or 0 on error.
+static int
+growuvm(pde_t *pgdir, uint oldsz, uint newsz, int perm)
 {
   char *mem;
   uint a;
@@ -238,7 +240,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       return 0;
     }
     memset(mem, 0, PGSIZE);
-    if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), perm) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
       kfree(mem);
@@ -248,6 +250,23 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   return newsz;
 }
 
+// Allocate page tables and physical memory to grow process from oldsz to
+// newsz, which need not be page aligned.  Returns new size or 0 on error.
+int
+allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  return growuvm(pgdir, oldsz, newsz, PTE_W|PTE_U);
+}
+
+// Like allocuvm, but the new pages stay shared with the
+// children this process forks, for memory used to
+// communicate between them.
+int
+allocshm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  return growuvm(pgdir, oldsz, newsz, PTE_W|PTE_U|PTE_SH);
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -310,40 +329,353 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
-// Given a parent process's page table, create a copy
-// of it for a child.
-pde_t*
-copyuvm(pde_t *pgdir, uint sz)
+// Copy the mapped pages of [start, end) from pgdir to d.
+// Pages never touched (see lazyfault, vmafault) stay
+// unmapped in the child too.
+static int
+copyrange(pde_t *pgdir, pde_t *d, uint start, uint end)
 {
-  pde_t *d;
   pte_t *pte;
   uint pa, i, flags;
   char *mem;
 
-  if((d = setupkvm()) == 0)
-    return 0;
-  for(i = 0; i < sz; i += PGSIZE){
+  for(i = start; i < end; i += PGSIZE){
     if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+      continue;
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
     pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
+    flags = PTE_FLAGS(*pte) & ~PTE_D;
+    if(flags & PTE_SH){
+      if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+        return -1;
+      kref(P2V(pa));
+      continue;
+    }
+    // Kernel-only pages (the stack guard page) are copied:
+    // cowfault() only handles user pages.
+    if(cow_enabled && (flags & PTE_U)){
+      if(flags & PTE_W){
+        flags = (flags & ~PTE_W) | PTE_COW;
+        *pte = pa | flags;
+      }
+      if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+        return -1;
+      kref(P2V(pa));
+      continue;
+    }
     if((mem = kalloc()) == 0)
-      goto bad;
+      return -1;
     memmove(mem, (char*)P2V(pa), PGSIZE);
+    if(flags & PTE_COW)
+      flags = (flags & ~PTE_COW) | PTE_W;
     if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
       kfree(mem);
-      goto bad;
+      return -1;
     }
   }
+  return 0;
+}
+
+// Given a parent process's page table, create a copy
+// of it for a child: memory below sz and the mmap()
+// regions in vma.  With cow_enabled the pages are not
+// copied: parent and child share them read-only, marked
+// PTE_COW, until cowfault() gives a writer its own copy.
+// MAP_SHARED pages (PTE_SH) stay shared and writable; fork()
+// maps all of them first, since a page missing here would be
+// faulted in separately by each process.
+// pgdir must be the current page table.
+pde_t*
+copyuvm(pde_t *pgdir, uint sz, struct vma *vma)
+{
+  pde_t *d;
+  struct vma *v;
+
+  if((d = setupkvm()) == 0)
+    return 0;
+  if(copyrange(pgdir, d, 0, sz) < 0)
+    goto bad;
+  for(v = vma; v < &vma[NVMA]; v++)
+    if(v->flags && v->start >= sz && copyrange(pgdir, d, v->start, v->end) < 0)
+      goto bad;
+  lcr3(V2P(pgdir));  // Flush the parent's now read-only entries
   return d;
 
 bad:
+  lcr3(V2P(pgdir));
   freevm(d);
   return 0;
 }
 
+// Handle a write fault at va on a copy-on-write page: take
+// a private copy of it, or just make it writable if no one
+// else still shares it.  Returns -1 if va is not a COW page.
+// Never sleeps, so it can run on faults taken in the kernel
+// (copyout, or writes through user pointers) with locks held.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (char*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(kpageref(P2V(pa)) == 1){
+    *pte = pa | flags;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  }
+  invlpg((void*)va);
+  return 0;
+}
+
+// sbrk() only moves p->sz; heap pages are mapped here, zeroed,
+// on the first access to them, from user code or from the
+// kernel using a user pointer.  Returns -1 if va is not a
+// page of the process (below sz) waiting to be mapped.
+int
+lazyfault(pde_t *pgdir, uint va, uint sz)
+{
+  pte_t *pte;
+  char *mem;
+
+  if(va >= sz || va >= KERNBASE)
+    return -1;
+  va = PGROUNDDOWN(va);
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if(pte && (*pte & PTE_P))
+    return -1;
+  if((mem = kalloc()) == 0){
+    cprintf("lazyfault: out of memory\n");
+    return -1;
+  }
+  memset(mem, 0, PGSIZE);
+  if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Map the page at va of a program segment or mmap() region
+// of p, reading it from the file, or zeroed for an anonymous
+// region.  May sleep, so the caller must hold no spinlocks.
+// Returns -1 if va is in no region or is already mapped.
+int
+vmafault(struct proc *p, uint va)
+{
+  struct vma *v;
+  pte_t *pte;
+  char *mem;
+  uint a, n;
+  int perm;
+
+  va = PGROUNDDOWN(va);
+  if((v = vmalookup(p->vma, va)) == 0)
+    return -1;
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+  if(pte && (*pte & PTE_P))
+    return -1;
+
+  if((mem = kalloc()) == 0){
+    cprintf("vmafault: out of memory\n");
+    return -1;
+  }
+  memset(mem, 0, PGSIZE);
+  a = va - v->start;
+  if(v->ip && a < v->filesz){
+    n = v->filesz - a;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    ilock(v->ip);
+    if(readi(v->ip, mem, v->off + a, n) != n){
+      iunlock(v->ip);
+      kfree(mem);
+      return -1;
+    }
+    iunlock(v->ip);
+  }
+  perm = PTE_U;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(v->flags & MAP_SHARED)
+    perm |= PTE_SH;
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), perm) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Return the region of vma holding va, or 0.
+struct vma*
+vmalookup(struct vma *vma, uint va)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++)
+    if(v->flags && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Does any region of vma overlap [start, end)?
+int
+vmaoverlap(struct vma *vma, uint start, uint end)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++)
+    if(v->flags && v->start < end && v->end > start)
+      return 1;
+  return 0;
+}
+
+// Write the dirty pages of a MAP_SHARED file region back
+// to the file, a few blocks per transaction like
+// filewrite(), never past the end the file had when it
+// was mapped.
+static void
+vmawriteback(pde_t *pgdir, struct vma *v)
+{
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+  pte_t *pte;
+  uint a, i, n, n1;
+  char *mem;
+
+  for(a = 0; a < v->filesz; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)(v->start + a), 0);
+    if(pte == 0 || (*pte & (PTE_P|PTE_D)) != (PTE_P|PTE_D))
+      continue;
+    mem = P2V(PTE_ADDR(*pte));
+    n = v->filesz - a;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    for(i = 0; i < n; i += n1){
+      n1 = n - i;
+      if(n1 > max)
+        n1 = max;
+      begin_op();
+      ilock(v->ip);
+      writei(v->ip, mem + i, v->off + a + i, n1);
+      iunlock(v->ip);
+      end_op();
+    }
+    *pte &= ~PTE_D;
+  }
+}
+
+// Release region v: write a MAP_SHARED file region back
+// if it was mapped in pgdir (pgdir may be 0), drop its file
+// reference and free the slot.  The pages themselves are
+// left to the caller.  Must not be called inside a
+// transaction.
+void
+vmaput(pde_t *pgdir, struct vma *v)
+{
+  if(v->ip){
+    if(pgdir && (v->flags & MAP_SHARED))
+      vmawriteback(pgdir, v);
+    begin_op();
+    iput(v->ip);
+    end_op();
+  }
+  memset(v, 0, sizeof(*v));
+}
+
+// Release every region of a region table, as vmaput().
+void
+vmaclear(pde_t *pgdir, struct vma *vma)
+{
+  struct vma *v;
+
+  for(v = vma; v < &vma[NVMA]; v++)
+    if(v->flags)
+      vmaput(pgdir, v);
+}
+
+// Copy region table src into dst for a child process.
+void
+vmadup(struct vma *dst, struct vma *src)
+{
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    dst[i] = src[i];
+    if(dst[i].ip)
+      idup(dst[i].ip);
+  }
+}
+
+// Is [va, va+n) user memory of p: below sz but not the
+// stack guard page, or inside one region, writable if write
+// is set?  The kernel writes to user memory directly and
+// cannot recover from a fault on a read-only page.
+int
+uvmvalid(struct proc *p, uint va, uint n, int write)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+
+  if(va + n < va)
+    return 0;
+  if(va + n <= p->sz){
+    for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+      pte = walkpgdir(p->pgdir, (char*)a, 0);
+      if(pte && (*pte & PTE_P) && (*pte & PTE_U) == 0)
+        return 0;
+    }
+    return 1;
+  }
+  if((v = vmalookup(p->vma, va)) == 0 || va + n > v->end)
+    return 0;
+  return !write || (v->prot & PROT_WRITE);
+}
+
+// Resolve a page fault at va in p: a write to a
+// copy-on-write page, or the first touch of a program,
+// mmap() or heap page.  Returns -1 if the access is not allowed.
+int
+uvmfault(struct proc *p, uint va, int write)
+{
+  if(write && cowfault(p->pgdir, va) == 0)
+    return 0;
+  if(vmafault(p, va) == 0)
+    return 0;
+  return lazyfault(p->pgdir, va, p->sz);
+}
+
+// Map any unmapped pages of [va, va+n) in the current
+// process ahead of the kernel using them through a user
+// pointer, since faults on them may have to sleep and the
+// kernel may use the pointer with a spinlock held.  Returns
+// -1 if some page cannot be mapped.
+int
+uvmpopulate(uint va, uint n)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if((pte == 0 || (*pte & PTE_P) == 0) && uvmfault(p, a, 0) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -352,7 +684,7 @@ uva2ka(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
@@ -361,19 +693,32 @@ uva2ka(pde_t *pgdir, char *uva)
 
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for PTE_U pages.
+// uva2ka ensures this only works for PTE_U pages, and
+// read-only pages are refused.
 int
 copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
+  pte_t *pte;
 
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    pte = walkpgdir(pgdir, (char*)va0, 0);
+    if(pte == 0 || (*pte & (PTE_P|PTE_COW)) != PTE_P){
+      // Not yet touched, or copy-on-write, in the current process.
+      if(myproc() == 0 || myproc()->pgdir != pgdir ||
+         uvmfault(myproc(), va0, 1) < 0)
+        return -1;
+    }
+    pte = walkpgdir(pgdir, (char*)va0, 0);
+    if(pte == 0 || (*pte & PTE_W) == 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;
+    *pte |= PTE_D;
     n = PGSIZE - (va - va0);
     if(n > len)
       n = len;
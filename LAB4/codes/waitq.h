@@ -0,0 +1,11 @@
+#ifndef __WAITQ_H__
+#define __WAITQ_H__
+
+// Processes sleeping on a lock or channel, oldest first.
+// Protected by the spinlock passed to sleepq().
+struct waitq {
+  struct proc *head;
+  struct proc *tail;
+};
+
+#endif